@@ -1,8 +1,40 @@
 #include <iostream>
+#include <memory>
 #include <windows.h>
 #include <cvid/Window.h>
+#include <cvid/FrameEncoder.h>
+#include <cvid/SharedFrameRing.h>
+#include <cvid/FrameCodec.h>
 #include <cvid/Helpers.h>
 
+//Room for every message other than frames, including the type byte
+constexpr size_t controlBufferSize = 512;
+
+//Is the message a frame
+static bool IsFrame(cvid::DataType type)
+{
+	return type == cvid::DataType::Frame || type == cvid::DataType::SharedFrame || type == cvid::DataType::CompressedFrame || type == cvid::DataType::DeltaFrame;
+}
+
+//Is another frame already waiting in the pipe
+static bool FrameWaiting(HANDLE pipe)
+{
+	char type;
+	DWORD numBytesRead = 0;
+	if (!PeekNamedPipe(pipe, &type, 1, &numBytesRead, NULL, NULL) || numBytesRead == 0)
+		return false;
+	return IsFrame((cvid::DataType)type);
+}
+
+//Tell the window a message has been handled, which lets it send another
+static bool SendStatus(HANDLE pipe, const cvid::FrameStatus& status)
+{
+	char message[1 + sizeof(status)];
+	message[0] = (char)cvid::DataType::Ready;
+	memcpy(message + 1, &status, sizeof(status));
+	return WriteFile(pipe, message, sizeof(message), NULL, NULL);
+}
+
 int main(int argc, char* argv[])
 {
 	uint16_t width = 0;
@@ -45,7 +77,7 @@ int main(int argc, char* argv[])
 	//Open the inbound pipe
 	HANDLE inPipe = CreateFileA(
 		(genericPipeName + "out").c_str(), //Outbound from server
-		GENERIC_READ, //Read only for this pipe
+		GENERIC_READ | FILE_WRITE_ATTRIBUTES, //Read only for this pipe, attributes to change the read mode
 		FILE_SHARE_READ | FILE_SHARE_WRITE,
 		NULL, //Security attributes
 		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL //Unimportant for pipes
@@ -57,9 +89,12 @@ int main(int argc, char* argv[])
 		return -2;
 	}
 
-	//Send a ready status
-	cvid::DataType ready = cvid::DataType::Ready;
-	bool sendSuccess = WriteFile(outPipe, &ready, 1 * sizeof(char), NULL, NULL);
+	//Several messages can be waiting, read them one at a time
+	DWORD readMode = PIPE_READMODE_MESSAGE;
+	SetNamedPipeHandleState(inPipe, &readMode, NULL, NULL);
+
+	//Send a ready status, the window counts it like a handled message
+	bool sendSuccess = SendStatus(outPipe, { 0, 0, false });
 
 	//Make sure the data was sent
 	if (!sendSuccess)
@@ -71,9 +106,16 @@ int main(int argc, char* argv[])
 	//Hide the cursor
 	std::cout << "\x1b[?25l";
 
-	size_t bufferSize = (sizeof(cvid::WindowProperties) + 1) * sizeof(char);
+	size_t bufferSize = controlBufferSize;
 	char* buffer = new char[bufferSize];
 
+	//Turns received frames into virtual terminal sequences
+	cvid::FrameEncoder encoder;
+	//Shared memory the frames come through, they only come through the pipe without it
+	std::unique_ptr<cvid::SharedFrameRing> frameRing;
+	//Rebuilds compressed frames, keeps the last one to apply differences to
+	cvid::FrameCodec frameCodec;
+
 	//Update loop
 	while (true)
 	{
@@ -95,8 +137,25 @@ int main(int argc, char* argv[])
 			return -2;
 		}
 
+		//Frames start with their sequence number and when they were sent, which go back in the status
+		cvid::DataType type = (cvid::DataType)buffer[0];
+		const char* data = buffer + 1;
+		size_t dataSize = numBytesRead - 1;
+		cvid::FrameStatus status{ 0, 0, false };
+		if (IsFrame(type))
+		{
+			cvid::FrameInfo info{};
+			memcpy(&info, data, std::min(dataSize, sizeof(info)));
+			data += sizeof(info);
+			dataSize -= std::min(dataSize, sizeof(info));
+			status.sequence = info.sequence;
+			status.timestamp = info.timestamp;
+		}
+		//When behind only the newest frame is drawn, older ones are still read to keep up the shared state
+		bool stale = IsFrame(type) && FrameWaiting(inPipe);
+
 		//Check the type of data received
-		switch ((cvid::DataType)buffer[0])
+		switch (type)
 		{
 		case cvid::DataType::String:
 			//Echo anything received
@@ -128,62 +187,89 @@ int main(int argc, char* argv[])
 				//TODO: Handle error
 			}
 
-			//Resize the buffer
-			bufferSize = (size_t)width * (height / 2) * sizeof(cvid::CharPixel);
+			//Resizing the console mangles its contents
+			encoder.Invalidate();
+
+			//Resize the buffer to fit a frame with its type and info, compressed frames can be slightly bigger
+			bufferSize = std::max(cvid::FrameCodec::MaxCompressedSize((size_t)width * (height / 2)) + 1 + sizeof(cvid::FrameInfo), controlBufferSize);
 			delete[] buffer;
 			buffer = new char[bufferSize];
 			break;
 		}
 
-		case cvid::DataType::Frame:
-			//Print an entire frame of data
-			cvid::CharPixel* pixelData = (cvid::CharPixel*)(buffer + 1);
-			std::string frameString;
-			frameString.reserve((size_t)29 * width * (height / 2));
+		case cvid::DataType::EncoderSettings:
+			//Change how frames are encoded
+			memcpy(&encoder.settings, buffer + 1, sizeof(encoder.settings));
+			encoder.Invalidate();
+			break;
 
-			//Set colors to black
-			std::cout << "\x1b[38;2;0;0;0m\x1b[48;2;0;0;0m";
+		case cvid::DataType::SharedRing:
+			//Open the shared memory frames come through
+			try
+			{
+				frameRing = std::make_unique<cvid::SharedFrameRing>(std::string(buffer + 1, numBytesRead - 1));
+			}
+			catch (const std::runtime_error&)
+			{
+				return -4;
+			}
+			break;
+
+		case cvid::DataType::SharedFrame:
+		{
+			//Print a frame straight from shared memory
+			uint64_t sequence;
+			memcpy(&sequence, data, sizeof(sequence));
 
-			cvid::Color currentBg{ 0, 0, 0 };
-			cvid::Color currentFg{ 0, 0, 0 };
-			//For every pixel in the framebuffer
-			for (size_t y = 0; y < height / 2; y++)
+			uint16_t frameWidth, frameHeight;
+			const cvid::CharPixel* pixelData = frameRing ? frameRing->Read(sequence, frameWidth, frameHeight) : nullptr;
+			if (!pixelData)
 			{
-				//Windows 11 broke scrolling, so do we it here. Also for some reason it starts from 1
-				frameString.append(std::format("\x1b[{};0f", y + 1));
-
-				for (size_t x = 0; x < width; x++)
-				{
-					cvid::CharPixel& thisPixel = pixelData[y * width + x];
-
-					//Change foreground color if it changes
-					if (thisPixel.fg.r != currentFg.r || thisPixel.fg.g != currentFg.g || thisPixel.fg.b != currentFg.b)
-					{
-						//Add the proper vts to the displayFrame
-						//Format: \x1b38;2;<r>;<g>;<b>;m
-						frameString.append(std::format("\x1b[38;2;{};{};{}m", thisPixel.fg.r, thisPixel.fg.g, thisPixel.fg.b));
-						currentFg = thisPixel.fg;
-					}
-					//Change background color if it changes
-					if (thisPixel.bg.r != currentBg.r || thisPixel.bg.g != currentBg.g || thisPixel.bg.b != currentBg.b)
-					{
-						//Add the proper vts to the displayFrame
-						//Format: \x1b48;2;<r>;<g>;<b>;m
-						frameString.append(std::format("\x1b[48;2;{};{};{}m", thisPixel.bg.r, thisPixel.bg.g, thisPixel.bg.b));
-						currentBg = thisPixel.bg;
-					}
-					frameString += thisPixel.character;
-				}
+				cvid::LogWarning("CVid warning in update window: Frame " + std::to_string(sequence) + " is not in shared memory");
+				break;
 			}
+			if (!stale)
+				std::cout << encoder.Encode(pixelData, frameWidth, frameHeight);
+			status.presented = !stale;
+
+			//Done with the slot
+			frameRing->Release(sequence);
+
+			//Differences are never made against shared memory frames
+			frameCodec.Reset();
+			break;
+		}
 
-			//Print frame
-			std::cout << frameString;
+		case cvid::DataType::CompressedFrame:
+		case cvid::DataType::DeltaFrame:
+		{
+			//Rebuild the frame and print it, stale frames are still rebuilt since the next one may be a difference to it
+			bool delta = type == cvid::DataType::DeltaFrame;
+			uint16_t frameWidth, frameHeight;
+			const cvid::CharPixel* pixelData = frameCodec.Decompress((const uint8_t*)data, dataSize, delta, frameWidth, frameHeight);
+			if (!pixelData)
+			{
+				cvid::LogWarning("CVid warning in update window: Received a broken compressed frame");
+				break;
+			}
+			if (!stale)
+				std::cout << encoder.Encode(pixelData, frameWidth, frameHeight);
+			status.presented = !stale;
+			break;
+		}
+
+		case cvid::DataType::Frame:
+			//Print an entire frame of data
+			const cvid::CharPixel* pixelData = (const cvid::CharPixel*)data;
+			if (!stale)
+				std::cout << encoder.Encode(pixelData, width, height / 2);
+			status.presented = !stale;
 
 			break;
 		}
 
 		//Send a ready status
-		sendSuccess = WriteFile(outPipe, &ready, 1 * sizeof(char), NULL, NULL);
+		sendSuccess = SendStatus(outPipe, status);
 
 		//Make sure the data was sent
 		if (!sendSuccess)
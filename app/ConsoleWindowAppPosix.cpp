@@ -0,0 +1,339 @@
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cvid/Window.h>
+#include <cvid/FrameEncoder.h>
+#include <cvid/FrameCodec.h>
+#include <cvid/SharedFrameRing.h>
+#include <cvid/SpscQueue.h>
+#include <cvid/Helpers.h>
+
+//The window process on Linux and macOS, it draws the frames of a Window in the terminal it is started in
+//Reading the socket, decoding frames, and writing to the terminal each have their own thread so none waits on another
+//Usage: ConsoleWindowApp <socket> [title]
+
+//Messages read from the socket but not decoded yet, more than can be in flight so the reader never waits
+constexpr size_t messageQueueSize = 16;
+//Encoded output not written to the terminal yet
+constexpr size_t outputQueueSize = 4;
+
+#ifdef MSG_NOSIGNAL
+constexpr int sendFlags = MSG_NOSIGNAL;
+#else
+constexpr int sendFlags = 0;
+#endif
+
+//Something for the writer thread to write
+struct Output
+{
+	std::string text;
+	//Sent back once the text is written, only for drawn frames
+	cvid::FrameStatus status;
+	bool hasStatus = false;
+};
+
+static int windowSocket = -1;
+//The decoder and writer both send statuses
+static std::mutex statusMutex;
+
+//Is the message a frame
+static bool IsFrame(cvid::DataType type)
+{
+	return type == cvid::DataType::Frame || type == cvid::DataType::SharedFrame || type == cvid::DataType::CompressedFrame || type == cvid::DataType::DeltaFrame;
+}
+
+//Read exactly size bytes, returns false if the window has gone
+static bool ReadAll(int fd, void* data, size_t size)
+{
+	char* bytes = (char*)data;
+	while (size > 0)
+	{
+		ssize_t numRead = read(fd, bytes, size);
+		if (numRead < 0 && errno == EINTR)
+			continue;
+		if (numRead <= 0)
+			return false;
+		bytes += numRead;
+		size -= numRead;
+	}
+	return true;
+}
+
+//Write all of some bytes, returns false on failure
+static bool WriteAll(int fd, const char* data, size_t size, bool socket)
+{
+	while (size > 0)
+	{
+		ssize_t written = socket ? send(fd, data, size, sendFlags) : write(fd, data, size);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		data += written;
+		size -= written;
+	}
+	return true;
+}
+
+//Tell the window a message has been handled, which lets it send another
+static bool SendStatus(const cvid::FrameStatus& status)
+{
+	char message[1 + sizeof(status)];
+	message[0] = (char)cvid::DataType::Ready;
+	memcpy(message + 1, &status, sizeof(status));
+
+	std::lock_guard<std::mutex> lock(statusMutex);
+	return WriteAll(windowSocket, message, sizeof(message), true);
+}
+
+//Read messages from the socket as fast as they come, each starts with its size
+static void ReadLoop(cvid::SpscQueue<std::vector<char>>* messages)
+{
+	while (true)
+	{
+		uint32_t size;
+		if (!ReadAll(windowSocket, &size, sizeof(size)) || size == 0)
+			break;
+
+		std::vector<char>* message = messages->BeginPush();
+		if (!message)
+			break;
+		message->resize(size);
+		if (!ReadAll(windowSocket, message->data(), size))
+			break;
+		messages->EndPush();
+	}
+	//The window has closed, let the decoder finish what is left
+	messages->Close();
+}
+
+//Write encoded output to the terminal
+static void WriteLoop(cvid::SpscQueue<Output>* outputs)
+{
+	while (Output* output = outputs->Front())
+	{
+		bool written = WriteAll(STDOUT_FILENO, output->text.data(), output->text.size(), false);
+		if (output->hasStatus)
+		{
+			output->status.presented = written;
+			SendStatus(output->status);
+		}
+		outputs->Pop();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	//Make sure we have the name of the socket
+	if (argc < 2)
+	{
+		cvid::LogError("CVid error in create window: No socket given");
+		return -1;
+	}
+
+	//Connect to the window
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, argv[1], sizeof(address.sun_path) - 1);
+	windowSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (windowSocket < 0 || connect(windowSocket, (sockaddr*)&address, sizeof(address)) != 0)
+	{
+		cvid::LogError("CVid error in create window: Failed to connect socket, " + std::string(strerror(errno)));
+		return -2;
+	}
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+	int noSigPipe = 1;
+	setsockopt(windowSocket, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+
+	//Keys typed into the terminal should not be echoed over the frames
+	termios originalTermios;
+	bool termiosChanged = false;
+	if (tcgetattr(STDIN_FILENO, &originalTermios) == 0)
+	{
+		termios raw = originalTermios;
+		raw.c_lflag &= ~(ICANON | ECHO);
+		termiosChanged = tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+	}
+
+	//Set the title, switch to the alternate screen, and hide the cursor
+	std::string setup = "\x1b]0;" + std::string(argc > 2 ? argv[2] : "CVid") + "\x07\x1b[?1049h\x1b[2J\x1b[?25l";
+	WriteAll(STDOUT_FILENO, setup.data(), setup.size(), false);
+
+	//Send a ready status, the window counts it like a handled message
+	if (!SendStatus({ 0, 0, false }))
+	{
+		cvid::LogWarning("CVid warning in Window: Failed to send status message, " + std::string(strerror(errno)));
+		return -3;
+	}
+
+	cvid::SpscQueue<std::vector<char>> messages(messageQueueSize);
+	cvid::SpscQueue<Output> outputs(outputQueueSize);
+	std::thread reader(ReadLoop, &messages);
+	std::thread writer(WriteLoop, &outputs);
+
+	uint16_t width = 0;
+	uint16_t height = 0;
+	//Turns received frames into virtual terminal sequences
+	cvid::FrameEncoder encoder;
+	//Shared memory the frames come through, they only come through the socket without it
+	std::unique_ptr<cvid::SharedFrameRing> frameRing;
+	//Rebuilds compressed frames, keeps the last one to apply differences to
+	cvid::FrameCodec frameCodec;
+	int exitCode = 0;
+
+	//Decode loop, runs until the window closes the socket
+	while (std::vector<char>* message = messages.Front())
+	{
+		//Frames start with their sequence number and when they were sent, which go back in the status
+		cvid::DataType type = (cvid::DataType)(*message)[0];
+		const char* data = message->data() + 1;
+		size_t dataSize = message->size() - 1;
+		cvid::FrameStatus status{ 0, 0, false };
+		if (IsFrame(type))
+		{
+			cvid::FrameInfo info{};
+			memcpy(&info, data, std::min(dataSize, sizeof(info)));
+			data += std::min(dataSize, sizeof(info));
+			dataSize -= std::min(dataSize, sizeof(info));
+			status.sequence = info.sequence;
+			status.timestamp = info.timestamp;
+		}
+		//When behind only the newest frame is drawn, older ones are still read to keep up the shared state
+		std::vector<char>* next = messages.PeekNext();
+		bool stale = IsFrame(type) && next && IsFrame((cvid::DataType)(*next)[0]);
+
+		//Decoded frame to draw, if any
+		const cvid::CharPixel* pixelData = nullptr;
+		uint16_t frameWidth = 0, frameHeight = 0;
+		//What to write to the terminal, if anything
+		std::string text;
+
+		//Check the type of data received
+		switch (type)
+		{
+		case cvid::DataType::String:
+			//Echo anything received
+			text.assign(data, strnlen(data, dataSize));
+			break;
+
+		case cvid::DataType::Properties:
+		{
+			//Get the window properties
+			cvid::WindowProperties properties;
+			memcpy(&properties, data, sizeof(properties));
+			width = properties.width;
+			height = properties.height;
+
+			//Terminals can not be resized reliably, xterm compatible ones take this and the rest ignore it
+			text = "\x1b[8;" + std::to_string((height + 1) / 2) + ";" + std::to_string(width) + "t\x1b[2J";
+			//Resizing the terminal mangles its contents
+			encoder.Invalidate();
+			break;
+		}
+
+		case cvid::DataType::EncoderSettings:
+			//Change how frames are encoded
+			memcpy(&encoder.settings, data, sizeof(encoder.settings));
+			encoder.Invalidate();
+			break;
+
+		case cvid::DataType::SharedRing:
+			//Open the shared memory frames come through
+			try
+			{
+				frameRing = std::make_unique<cvid::SharedFrameRing>(std::string(data, dataSize));
+			}
+			catch (const std::runtime_error&)
+			{
+				exitCode = -4;
+			}
+			break;
+
+		case cvid::DataType::SharedFrame:
+		{
+			uint64_t sequence;
+			memcpy(&sequence, data, sizeof(sequence));
+			pixelData = frameRing ? frameRing->Read(sequence, frameWidth, frameHeight) : nullptr;
+			if (!pixelData)
+				cvid::LogWarning("CVid warning in update window: Frame " + std::to_string(sequence) + " is not in shared memory");
+			else if (!stale)
+				text = encoder.Encode(pixelData, frameWidth, frameHeight);
+
+			//Done with the slot, the frame is encoded or skipped
+			if (pixelData)
+				frameRing->Release(sequence);
+			//Differences are never made against shared memory frames
+			frameCodec.Reset();
+			break;
+		}
+
+		case cvid::DataType::CompressedFrame:
+		case cvid::DataType::DeltaFrame:
+			//Rebuild the frame, stale frames are still rebuilt since the next one may be a difference to it
+			pixelData = frameCodec.Decompress((const uint8_t*)data, dataSize, type == cvid::DataType::DeltaFrame, frameWidth, frameHeight);
+			if (!pixelData)
+				cvid::LogWarning("CVid warning in update window: Received a broken compressed frame");
+			else if (!stale)
+				text = encoder.Encode(pixelData, frameWidth, frameHeight);
+			break;
+
+		case cvid::DataType::Frame:
+			//An entire frame of data
+			pixelData = (const cvid::CharPixel*)data;
+			if (!stale && dataSize >= (size_t)width * (height / 2) * sizeof(cvid::CharPixel))
+				text = encoder.Encode(pixelData, width, height / 2);
+			break;
+
+		default:
+			break;
+		}
+		messages.Pop();
+
+		if (exitCode != 0)
+			break;
+
+		//Frames are acknowledged once written so the window sees how far behind the terminal is
+		if (!text.empty())
+		{
+			Output* output = outputs.BeginPush();
+			if (!output)
+				break;
+			output->text.assign(text);
+			output->status = status;
+			output->hasStatus = IsFrame(type);
+			outputs.EndPush();
+			if (IsFrame(type))
+				continue;
+		}
+
+		//Send a ready status, failing means the window has closed
+		if (!SendStatus(status))
+			break;
+	}
+
+	//Let the writer finish, then stop the reader by closing the socket
+	outputs.Close();
+	writer.join();
+	messages.Close();
+	shutdown(windowSocket, SHUT_RDWR);
+	reader.join();
+	close(windowSocket);
+
+	//Show the cursor and go back to the normal screen
+	constexpr char restore[] = "\x1b[0m\x1b[?25h\x1b[?1049l";
+	WriteAll(STDOUT_FILENO, restore, sizeof(restore) - 1, false);
+	if (termiosChanged)
+		tcsetattr(STDIN_FILENO, TCSANOW, &originalTermios);
+	return exitCode;
+}
\ No newline at end of file
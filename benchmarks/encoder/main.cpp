@@ -0,0 +1,180 @@
+#include <iostream>
+#include <format>
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <cvid/FrameEncoder.h>
+#include <cvid/FrameCodec.h>
+#include <cvid/Helpers.h>
+
+//The frame encoding loop Window::DrawFrame used before FrameEncoder, kept as the baseline
+std::string LegacyEncode(const cvid::CharPixel* frame, uint16_t width, uint16_t height)
+{
+	std::string frameString;
+	frameString.reserve((size_t)29 * width * height);
+
+	frameString.append("\x1b[38;2;0;0;0m\x1b[48;2;0;0;0m");
+
+	cvid::Color currentBg{ 0, 0, 0 };
+	cvid::Color currentFg{ 0, 0, 0 };
+	for (size_t y = 0; y < height; y++)
+	{
+		frameString.append(std::format("\x1b[{};0f", y + 1));
+
+		for (size_t x = 0; x < width; x++)
+		{
+			const cvid::CharPixel& thisPixel = frame[y * width + x];
+
+			if (thisPixel.fg.r != currentFg.r || thisPixel.fg.g != currentFg.g || thisPixel.fg.b != currentFg.b)
+			{
+				frameString.append(std::format("\x1b[38;2;{};{};{}m", thisPixel.fg.r, thisPixel.fg.g, thisPixel.fg.b));
+				currentFg = thisPixel.fg;
+			}
+			if (thisPixel.bg.r != currentBg.r || thisPixel.bg.g != currentBg.g || thisPixel.bg.b != currentBg.b)
+			{
+				frameString.append(std::format("\x1b[48;2;{};{};{}m", thisPixel.bg.r, thisPixel.bg.g, thisPixel.bg.b));
+				currentBg = thisPixel.bg;
+			}
+			frameString += thisPixel.character;
+		}
+	}
+
+	return frameString;
+}
+
+//Fill a frame with a textured looking pattern, every cell changes color like a worst case scene
+void MakeFrame(std::vector<cvid::CharPixel>& frame, uint16_t width, uint16_t height, int seed)
+{
+	for (size_t y = 0; y < height; y++)
+	{
+		for (size_t x = 0; x < width; x++)
+		{
+			uint8_t v = (uint8_t)((x * 7 + y * 13 + seed) ^ (x * y + seed * 3));
+			frame[y * width + x] = { { v, (uint8_t)(v / 2), (uint8_t)(255 - v) }, { (uint8_t)(v + 40), v, (uint8_t)(v / 3) }, (char)223 };
+		}
+	}
+}
+
+//Run an encoder over some frames and print its throughput
+template<typename EncodeFunction>
+void Benchmark(const std::string& name, const std::vector<std::vector<cvid::CharPixel>>& frames, int iterations, EncodeFunction encode)
+{
+	size_t totalBytes = 0;
+
+	cvid::StartTimePoint();
+	for (int i = 0; i < iterations; i++)
+		totalBytes += encode(frames[i % frames.size()].data());
+	double seconds = cvid::EndTimePoint();
+
+	std::cout << std::format("{:<28}{:>10.1f} MB/s {:>10.0f} frames/s {:>10} bytes/frame\n",
+		name, totalBytes / seconds / 1e6, iterations / seconds, totalBytes / iterations);
+}
+
+int main(int argc, char* argv[])
+{
+	//Same size as demo2
+	const uint16_t width = 170;
+	const uint16_t height = 50;
+	const int iterations = argc > 1 ? std::stoi(argv[1]) : 2000;
+
+	//A few different frames so nothing gets cached between iterations
+	std::vector<std::vector<cvid::CharPixel>> frames(8, std::vector<cvid::CharPixel>((size_t)width * height));
+	for (size_t i = 0; i < frames.size(); i++)
+		MakeFrame(frames[i], width, height, (int)i);
+
+	std::cout << std::format("Encoding {}x{} frames, {} iterations\n", width, height, iterations);
+
+	Benchmark("std::format (legacy)", frames, iterations, [&](const cvid::CharPixel* frame)
+		{
+			return LegacyEncode(frame, width, height).size();
+		});
+
+	cvid::FrameEncoder encoder;
+	encoder.settings.deltaFrames = false;
+	Benchmark("FrameEncoder", frames, iterations, [&](const cvid::CharPixel* frame)
+		{
+			return encoder.Encode(frame, width, height).size();
+		});
+
+	encoder.settings.colorMode = cvid::ColorMode::Palette256;
+	Benchmark("FrameEncoder 256 colors", frames, iterations, [&](const cvid::CharPixel* frame)
+		{
+			return encoder.Encode(frame, width, height).size();
+		});
+
+	encoder.settings.colorMode = cvid::ColorMode::Palette16;
+	Benchmark("FrameEncoder 16 colors", frames, iterations, [&](const cvid::CharPixel* frame)
+		{
+			return encoder.Encode(frame, width, height).size();
+		});
+
+	//Multithreaded encoding of a large frame, like a maximized window on a big monitor
+	const uint16_t wideWidth = 480;
+	const uint16_t wideHeight = 130;
+	std::vector<std::vector<cvid::CharPixel>> wideFrames(4, std::vector<cvid::CharPixel>((size_t)wideWidth * wideHeight));
+	for (size_t i = 0; i < wideFrames.size(); i++)
+		MakeFrame(wideFrames[i], wideWidth, wideHeight, (int)i);
+
+	std::cout << std::format("\nEncoding {}x{} frames, {} iterations\n", wideWidth, wideHeight, iterations / 4);
+
+	cvid::FrameEncoder singleEncoder;
+	singleEncoder.settings.deltaFrames = false;
+	std::string reference(singleEncoder.Encode(wideFrames[0].data(), wideWidth, wideHeight));
+
+	for (uint16_t threads : { 1, 2, 4, 8 })
+	{
+		cvid::FrameEncoder threadedEncoder;
+		threadedEncoder.settings.deltaFrames = false;
+		threadedEncoder.settings.numThreads = threads;
+
+		//Output has to be the same for any amount of threads
+		if (threadedEncoder.Encode(wideFrames[0].data(), wideWidth, wideHeight) != reference)
+			cvid::LogError(std::format("Output with {} threads differs from 1 thread", threads));
+
+		Benchmark(std::format("FrameEncoder {} threads", threads), wideFrames, iterations / 4, [&](const cvid::CharPixel* frame)
+			{
+				return threadedEncoder.Encode(frame, wideWidth, wideHeight).size();
+			});
+	}
+
+	//Compressing frames for the window process, a small square moving over a still background like a low motion scene
+	std::cout << std::format("\nCompressing {}x{} frames, {} iterations\n", width, height, iterations);
+
+	std::vector<std::vector<cvid::CharPixel>> movingFrames(8, frames[0]);
+	for (size_t i = 0; i < movingFrames.size(); i++)
+		for (size_t y = 10; y < 20; y++)
+			for (size_t x = 20 + i * 4; x < 40 + i * 4; x++)
+				movingFrames[i][y * width + x] = { { 255, 255, 255 }, { 200, 40, 40 }, (char)223 };
+
+	for (bool delta : { false, true })
+	{
+		cvid::FrameCodec compressor;
+		cvid::FrameCodec decompressor;
+		bool broken = false;
+
+		Benchmark(delta ? "FrameCodec delta" : "FrameCodec", movingFrames, iterations, [&](const cvid::CharPixel* frame)
+			{
+				if (!delta)
+				{
+					compressor.Reset();
+					decompressor.Reset();
+				}
+				bool isDelta;
+				const std::vector<uint8_t>& compressed = compressor.Compress(frame, width, height, isDelta);
+
+				//Has to come back exactly the same
+				uint16_t w, h;
+				const cvid::CharPixel* decompressed = decompressor.Decompress(compressed.data(), compressed.size(), isDelta, w, h);
+				if (!decompressed || memcmp(decompressed, frame, (size_t)width * height * sizeof(cvid::CharPixel)) != 0)
+					broken = true;
+				return compressed.size();
+			});
+
+		if (broken)
+			cvid::LogError("Decompressed frame differs from the original");
+	}
+	std::cout << std::format("{:<28}{:>48} bytes/frame\n", "Uncompressed", (size_t)width * height * sizeof(cvid::CharPixel));
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include <iostream>
+#include <format>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <cvid/Window.h>
+#include <cvid/FrameEncoder.h>
+#include <cvid/Helpers.h>
+
+//Same size as demo2
+const uint16_t width = 170;
+const uint16_t height = 100;
+
+//Fill a frame with a textured looking pattern, every cell changes color like a worst case scene
+void MakeFrame(std::vector<cvid::CharPixel>& frame, int seed)
+{
+	for (size_t y = 0; y < height / 2; y++)
+	{
+		for (size_t x = 0; x < width; x++)
+		{
+			uint8_t v = (uint8_t)((x * 7 + y * 13 + seed) ^ (x * y + seed * 3));
+			frame[y * width + x] = { { v, (uint8_t)(v / 2), (uint8_t)(255 - v) }, { (uint8_t)(v + 40), v, (uint8_t)(v / 3) }, (char)223 };
+		}
+	}
+}
+
+//Time only the present step of some frames and print the throughput
+template<typename FillFunction, typename PresentFunction>
+void Benchmark(FILE* results, const std::string& name, int iterations, std::atomic<size_t>& drained, FillFunction fill, PresentFunction present)
+{
+	size_t drainedBefore = drained;
+	std::chrono::duration<double> presentTime{ 0 };
+	for (int i = 0; i < iterations; i++)
+	{
+		fill(i);
+		auto start = std::chrono::steady_clock::now();
+		present();
+		presentTime += std::chrono::steady_clock::now() - start;
+	}
+	double seconds = presentTime.count();
+	size_t bytes = drained - drainedBefore;
+
+	fprintf(results, "%s", std::format("{:<28}{:>10.1f} MB/s {:>10.0f} frames/s\n", name, bytes / seconds / 1e6, iterations / seconds).c_str());
+	fflush(results);
+}
+
+int main(int argc, char* argv[])
+{
+	const int iterations = argc > 1 ? std::stoi(argv[1]) : 1000;
+
+	//Open a pty big enough for the window
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+	{
+		cvid::LogError("Failed to open a pty");
+		return 1;
+	}
+	int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	winsize size{ width + 10, height / 2 + 10, 0, 0 };
+	ioctl(slave, TIOCSWINSZ, &size);
+
+	//Read everything written to the pty like a terminal would
+	std::atomic<size_t> drained = 0;
+	std::thread drainThread([&]()
+		{
+			std::vector<char> buffer(1 << 16);
+			while (true)
+			{
+				ssize_t numRead = read(master, buffer.data(), buffer.size());
+				if (numRead <= 0)
+					return;
+				drained += numRead;
+			}
+		});
+
+	//Point stdout and stdin at the pty, results go to the real stdout
+	int resultsFd = dup(STDOUT_FILENO);
+	int stdinFd = dup(STDIN_FILENO);
+	FILE* results = fdopen(resultsFd, "w");
+	std::cout.flush();
+	dup2(slave, STDOUT_FILENO);
+	dup2(slave, STDIN_FILENO);
+
+	fprintf(results, "Presenting %dx%d frames to a pty, %d iterations\n", width, height, iterations);
+
+	std::vector<std::vector<cvid::CharPixel>> frames(8, std::vector<cvid::CharPixel>((size_t)width * (height / 2)));
+	for (size_t i = 0; i < frames.size(); i++)
+		MakeFrame(frames[i], (int)i);
+
+	{
+		//Joining the bands into one string and writing it through std::cout
+		cvid::FrameEncoder encoder;
+		encoder.settings.deltaFrames = false;
+		const cvid::CharPixel* frame = nullptr;
+		Benchmark(results, "Joined std::cout", iterations, drained, [&](int i)
+			{
+				frame = frames[i % frames.size()].data();
+			}, [&]()
+			{
+				std::cout << encoder.Encode(frame, width, height / 2);
+				std::cout.flush();
+			});
+
+		//Window writing each band with writev
+		cvid::Window window(width, height, "Present benchmark");
+		cvid::EncoderSettings settings;
+		settings.deltaFrames = false;
+		window.SetEncoderSettings(settings);
+		Benchmark(results, "Window writev", iterations, drained, [&](int i)
+			{
+				const std::vector<cvid::CharPixel>& source = frames[i % frames.size()];
+				for (uint16_t y = 0; y < height / 2; y++)
+					for (uint16_t x = 0; x < width; x++)
+						window.PutChar(x, y, source[(size_t)y * width + x]);
+			}, [&]()
+			{
+				window.DrawFrame();
+			});
+	}
+
+	//Close every copy of the slave so the drain thread sees the end
+	dup2(stdinFd, STDIN_FILENO);
+	dup2(resultsFd, STDOUT_FILENO);
+	close(slave);
+	drainThread.join();
+	close(master);
+	fclose(results);
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,313 @@
+#include <iostream>
+#include <format>
+#include <random>
+#include <vector>
+#include <cmath>
+#include <string>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <cvid/Window.h>
+#include <cvid/Rasterizer.h>
+#include <cvid/Renderer.h>
+#include <cvid/Camera.h>
+#include <cvid/Model.h>
+#include <cvid/Helpers.h>
+
+//Every heap allocation made by the process, counted to check that drawing does not allocate once warmed up
+static std::atomic<size_t> allocations = 0;
+
+void* operator new(size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* memory = std::malloc(size ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+//Same size as demo2
+const uint16_t width = 170;
+const uint16_t height = 100;
+
+//Make some random triangles, always the same ones
+std::vector<std::pair<cvid::Tri, cvid::Color>> MakeTriangles(size_t count)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<double> xDist(-20, width + 20);
+	std::uniform_real_distribution<double> yDist(-20, height + 20);
+	std::uniform_real_distribution<double> zDist(1, 100);
+	std::uniform_int_distribution<int> colorDist(0, 255);
+
+	std::vector<std::pair<cvid::Tri, cvid::Color>> triangles(count);
+	for (auto& [tri, color] : triangles)
+	{
+		tri.v0 = cvid::Vector3(xDist(rng), yDist(rng), zDist(rng));
+		tri.v1 = cvid::Vector3(xDist(rng), yDist(rng), zDist(rng));
+		tri.v2 = cvid::Vector3(xDist(rng), yDist(rng), zDist(rng));
+		color = { (uint8_t)colorDist(rng), (uint8_t)colorDist(rng), (uint8_t)colorDist(rng) };
+	}
+	return triangles;
+}
+
+//Print how fast a scene was drawn and the hash of its last frame, the hash should only change if the output does
+//Triangles count everything submitted, including ones which get culled
+//Allocations are counted from the end of the first frame, by which time the reused buffers have grown, so there should be none
+void PrintResult(const std::string& name, int frames, double seconds, size_t triangles, size_t steadyAllocations, cvid::Window& window)
+{
+	std::cout << std::format("{:<30}{:>10.0f} frames/s {:>12.0f} triangles/s {:>8.2f} allocations/frame   hash {:016x}\n",
+		name, frames / seconds, triangles / seconds, frames > 1 ? (double)steadyAllocations / (frames - 1) : 0.0, window.HashFrame());
+	if (steadyAllocations != 0)
+		cvid::LogError(std::format("{} allocated {} times after the first frame", name, steadyAllocations));
+}
+
+int main(int argc, char* argv[])
+{
+	const int iterations = argc > 1 ? std::stoi(argv[1]) : 200;
+	//Optionally save the last frame of each scene to this folder
+	const std::string saveFolder = argc > 2 ? argv[2] : "";
+
+	cvid::Window window(width, height, "Raster benchmark", cvid::WindowMode::Headless);
+	const cvid::Color bgColor = { 12, 12, 12 };
+
+	std::cout << std::format("Rasterizing {}x{} frames, {} iterations\n", width, height, iterations);
+
+	//Flat colored triangles
+	std::vector<std::pair<cvid::Tri, cvid::Color>> triangles = MakeTriangles(200);
+
+	//A lit and textured model turning around
+	cvid::Model model(std::string(CVID_RESOURCES) + "Suzanne.obj");
+	cvid::ModelInstance instance(&model);
+	instance.SetScale(35);
+	instance.SetPosition({ 0, 0, 0 });
+
+	cvid::Camera cam(cvid::Vector3(0, -15, 150), width, height);
+	cam.MakePerspective(90, 1, 5000);
+
+	//Every scene with every rasterizer, both fill the same pixels so their hashes match
+	struct Mode
+	{
+		cvid::RasterMode mode;
+		std::string label;
+		std::string fileSuffix;
+	};
+	const Mode modes[] = { { cvid::RasterMode::Scanline, "", "" }, { cvid::RasterMode::Tiled, " tiled", "_tiled" } };
+	uint64_t trianglesHash = 0;
+	uint64_t suzanneHash = 0;
+	for (const auto& [mode, label, fileSuffix] : modes)
+	{
+		cvid::rasterMode = mode;
+		cvid::ambientLightIntensity = 1;
+		cvid::directionalLightIntensity = 0;
+
+		size_t warmAllocations = 0;
+		cvid::StartTimePoint();
+		for (int i = 0; i < iterations; i++)
+		{
+			window.Fill(bgColor);
+			window.ClearDepthBuffer();
+			for (const auto& [tri, color] : triangles)
+				cvid::RasterizeTriangle(&window, tri, color);
+			if (i == 0)
+				warmAllocations = allocations;
+		}
+		double seconds = cvid::EndTimePoint();
+		size_t steadyAllocations = allocations - warmAllocations;
+		PrintResult("RasterizeTriangle" + label, iterations, seconds, triangles.size() * iterations, steadyAllocations, window);
+		if (!saveFolder.empty())
+			window.SaveFrame(saveFolder + "/triangles" + fileSuffix + ".ppm");
+		if (mode == cvid::RasterMode::Scanline)
+			trianglesHash = window.HashFrame();
+		else if (window.HashFrame() != trianglesHash)
+			cvid::LogError("Triangles" + label + " differ from the scanline rasterizer");
+
+		cvid::ambientLightIntensity = 0.5;
+		cvid::directionalLight = { 0, 0.5, 0.5 };
+		cvid::directionalLightIntensity = 1;
+
+		cvid::StartTimePoint();
+		for (int i = 0; i < iterations; i++)
+		{
+			window.Fill(bgColor);
+			window.ClearDepthBuffer();
+			instance.SetRotation({ 0, cvid::Radians(i * 3.0), 0 });
+			cvid::DrawModel(&instance, &cam, &window);
+			if (i == 0)
+				warmAllocations = allocations;
+		}
+		seconds = cvid::EndTimePoint();
+		steadyAllocations = allocations - warmAllocations;
+		PrintResult("DrawModel Suzanne" + label, iterations, seconds, model.faces.size() * iterations, steadyAllocations, window);
+		if (!saveFolder.empty())
+			window.SaveFrame(saveFolder + "/suzanne" + fileSuffix + ".ppm");
+		if (mode == cvid::RasterMode::Scanline)
+			suzanneHash = window.HashFrame();
+		else if (window.HashFrame() != suzanneHash)
+			cvid::LogError("Suzanne" + label + " differs from the scanline rasterizer");
+	}
+
+	//Every depth format, their hashes differ where faces are close together since Float64 has a tolerance and the others do not
+	struct Format
+	{
+		cvid::DepthFormat format;
+		std::string label;
+	};
+	const Format formats[] = { { cvid::DepthFormat::Float64, "Float64" }, { cvid::DepthFormat::Float32Reversed, "Float32Reversed" },
+		{ cvid::DepthFormat::Fixed24, "Fixed24" }, { cvid::DepthFormat::Fixed16, "Fixed16" } };
+	cvid::rasterMode = cvid::RasterMode::Scanline;
+	std::cout << "\nDepth formats\n";
+	for (const auto& [format, label] : formats)
+	{
+		window.SetDepthFormat(format);
+		size_t warmAllocations = 0;
+		cvid::StartTimePoint();
+		for (int i = 0; i < iterations; i++)
+		{
+			window.Fill(bgColor);
+			window.ClearDepthBuffer();
+			instance.SetRotation({ 0, cvid::Radians(i * 3.0), 0 });
+			cvid::DrawModel(&instance, &cam, &window);
+			if (i == 0)
+				warmAllocations = allocations;
+		}
+		double seconds = cvid::EndTimePoint();
+		size_t steadyAllocations = allocations - warmAllocations;
+		PrintResult("DrawModel " + label, iterations, seconds, model.faces.size() * iterations, steadyAllocations, window);
+		if (!saveFolder.empty())
+			window.SaveFrame(saveFolder + "/suzanne_" + label + ".ppm");
+	}
+	window.SetDepthFormat(cvid::DepthFormat::Float64);
+
+	//A model near the camera hiding a grid of models behind it, drawn front to back
+	cvid::ModelInstance occluder(&model);
+	occluder.SetScale(60);
+	occluder.SetPosition({ 0, -15, 30 });
+	std::vector<cvid::ModelInstance> hidden;
+	for (int x = -2; x <= 2; x++)
+		for (int y = -1; y <= 1; y++)
+		{
+			hidden.emplace_back(&model);
+			hidden.back().SetScale(12);
+			hidden.back().SetPosition({ x * 20.0, y * 20.0 - 15, -150 });
+		}
+
+	window.SetDepthFormat(cvid::DepthFormat::Float32Reversed);
+	std::cout << "\nOcclusion culling with Float32Reversed\n";
+	uint64_t unculledHash = 0;
+	for (bool culling : { false, true })
+	{
+		window.enableOcclusionCulling = culling;
+		size_t warmAllocations = 0;
+		cvid::StartTimePoint();
+		for (int i = 0; i < iterations; i++)
+		{
+			window.Fill(bgColor);
+			window.ClearDepthBuffer();
+			occluder.SetRotation({ 0, cvid::Radians(std::sin(i * 0.1) * 20), 0 });
+			cvid::DrawModel(&occluder, &cam, &window);
+			for (cvid::ModelInstance& instance : hidden)
+				cvid::DrawModel(&instance, &cam, &window);
+			if (i == 0)
+				warmAllocations = allocations;
+		}
+		double seconds = cvid::EndTimePoint();
+		size_t steadyAllocations = allocations - warmAllocations;
+		PrintResult(culling ? "DrawModel culled" : "DrawModel not culled", iterations, seconds, model.faces.size() * (hidden.size() + 1) * iterations, steadyAllocations, window);
+		if (!saveFolder.empty())
+			window.SaveFrame(saveFolder + (culling ? "/occlusionCulled.ppm" : "/occlusion.ppm"));
+		if (!culling)
+			unculledHash = window.HashFrame();
+		else if (window.HashFrame() != unculledHash)
+			cvid::LogError("Output with occlusion culling differs from without");
+	}
+	window.SetDepthFormat(cvid::DepthFormat::Float64);
+
+	//A textured model with a lot of overdraw, shaded as it is drawn and once per pixel after
+	cvid::Model ship(std::string(CVID_RESOURCES) + "Achelous.obj");
+	cvid::ModelInstance shipInstance(&ship);
+	shipInstance.SetScale(60);
+	shipInstance.SetPosition({ 0, 0, 0 });
+	std::cout << "\nDeferred shading\n";
+	uint64_t forwardHash = 0;
+	for (auto [deferred, threads] : { std::pair{ false, 1 }, { true, 1 }, { true, 4 } })
+	{
+		cvid::deferredShading = deferred;
+		cvid::rasterThreads = threads;
+		size_t warmAllocations = 0;
+		cvid::StartTimePoint();
+		for (int i = 0; i < iterations; i++)
+		{
+			window.Fill(bgColor);
+			window.ClearDepthBuffer();
+			shipInstance.SetRotation({ cvid::Radians(20), cvid::Radians(i * 3.0), 0 });
+			cvid::DrawModel(&shipInstance, &cam, &window);
+			if (deferred)
+				cvid::ShadeDeferred(&window);
+			if (i == 0)
+				warmAllocations = allocations;
+		}
+		double seconds = cvid::EndTimePoint();
+		size_t steadyAllocations = allocations - warmAllocations;
+		std::string label = deferred ? std::format("DrawModel deferred {} threads", threads) : "DrawModel forward";
+		PrintResult(label, iterations, seconds, ship.faces.size() * iterations, steadyAllocations, window);
+		if (!saveFolder.empty())
+			window.SaveFrame(saveFolder + (deferred ? "/achelousDeferred.ppm" : "/achelous.ppm"));
+
+		//Shading each pixel once has to give the same frame
+		if (!deferred)
+			forwardHash = window.HashFrame();
+		else if (window.HashFrame() != forwardHash)
+			cvid::LogError(label + " differs from shading while drawing");
+	}
+	cvid::deferredShading = false;
+	cvid::rasterThreads = 1;
+
+	//Multithreaded rasterizing of a large frame, like a maximized window on a big monitor
+	const uint16_t wideWidth = 480;
+	const uint16_t wideHeight = 260;
+	cvid::Window wideWindow(wideWidth, wideHeight, "Raster benchmark", cvid::WindowMode::Headless);
+	cvid::Camera wideCam(cvid::Vector3(0, -15, 150), wideWidth, wideHeight);
+	wideCam.MakePerspective(90, 1, 5000);
+	instance.SetScale(90);
+	std::cout << std::format("\nRasterizing {}x{} frames on several threads\n", wideWidth, wideHeight);
+
+	for (const auto& [mode, label, fileSuffix] : modes)
+	{
+		cvid::rasterMode = mode;
+		uint64_t reference = 0;
+		for (uint16_t threads : { 1, 2, 4, 8 })
+		{
+			cvid::rasterThreads = threads;
+			size_t warmAllocations = 0;
+			cvid::StartTimePoint();
+			for (int i = 0; i < iterations; i++)
+			{
+				wideWindow.Fill(bgColor);
+				wideWindow.ClearDepthBuffer();
+				instance.SetRotation({ 0, cvid::Radians(i * 3.0), 0 });
+				cvid::DrawModel(&instance, &wideCam, &wideWindow);
+				if (i == 0)
+					warmAllocations = allocations;
+			}
+			double seconds = cvid::EndTimePoint();
+			size_t steadyAllocations = allocations - warmAllocations;
+			PrintResult(std::format("DrawModel{} {} threads", label, threads), iterations, seconds, model.faces.size() * iterations, steadyAllocations, wideWindow);
+
+			//Output has to be the same for any amount of threads
+			if (threads == 1)
+				reference = wideWindow.HashFrame();
+			else if (wideWindow.HashFrame() != reference)
+				cvid::LogError(std::format("Output with {} threads differs from 1 thread", threads));
+		}
+	}
+	cvid::rasterThreads = 1;
+
+	return 0;
+}
\ No newline at end of file
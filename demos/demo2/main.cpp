@@ -8,6 +8,7 @@
 #include <cvid/Model.h>
 #include <cvid/Matrix.h>
 #include <cvid/Math.h>
+#include <cvid/QualityController.h>
 #include <quaternion.h>
 
 //https://gabrielgambetta.com/computer-graphics-from-scratch/
@@ -58,6 +59,12 @@ int main()
 	cvid::Vector2Int windowSize = { std::min((int64_t)170, maxWindowSize.x), std::min((int64_t)100, maxWindowSize.y) };
 	cvid::Window window(windowSize.x, windowSize.y, "CVid Demo", false);
 	window.enableDepthTest = true;
+	//Half the depth buffer memory of the default, and faces close together no longer depend on a tolerance
+	window.SetDepthFormat(cvid::DepthFormat::Float32Reversed);
+	//Present in the background so rendering the next frame overlaps with drawing this one
+	window.SetPresentMode(cvid::PresentMode::LatestFrame);
+	//Trade quality for a steady frame rate when the console or machine is slow
+	cvid::QualityController quality(&window, 30);
 
 	//Make camera
 	cvid::Camera cam(cvid::Vector3(0, -15, 150), windowSize.x, windowSize.y);
@@ -140,10 +147,10 @@ int main()
 	while (true)
 	{
 		cvid::StartTimePoint();
+		quality.BeginFrame();
 
-		//Start rendering
+		//Start rendering, DrawFrame already cleared the depth buffer
 		window.Fill(bgColor);
-		window.ClearDepthBuffer();
 
 		if (GetKeyState(VK_ESCAPE) & 0x8000)
 			break;
@@ -389,16 +396,21 @@ int main()
 			window.PutString(infoPos + cvid::Vector2Int(-8, 1), render, bgColor);
 			window.PutString(infoPos + cvid::Vector2Int(-8, 2), latency, bgColor);
 			window.PutString(infoPos + cvid::Vector2Int(0, 3), fps, bgColor);
+			std::string qualityText = quality.Describe();
+			window.PutString(windowSize.x - (int)qualityText.size() - 2, 5, qualityText, bgColor);
 		}
 
 		double renderDone = cvid::EndTimePoint();
 		avgRender += renderDone;
 
+		quality.BeginPresent();
 		if (!window.DrawFrame())
 			return 0;
 		//For some reason this stops the window from freezing
 		window.SendData("\x1b[0;0H", 7, cvid::DataType::String);
 
+		quality.EndFrame();
+
 		double response = cvid::EndTimePoint();
 		avgLatency += response - renderDone;
 
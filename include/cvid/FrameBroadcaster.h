@@ -0,0 +1,86 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <cstdint>
+#include <cvid/Types.h>
+#include <cvid/FrameEncoder.h>
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#endif
+
+namespace cvid
+{
+	//Sends frames to any number of terminals connected over a socket, for example with nc -U <path> or nc localhost <port>
+	//Each frame is encoded once as a delta for every viewer which is up to date, and once as a keyframe if anyone needs one
+	//Nothing ever blocks, viewers which fall behind skip frames until they can take a keyframe
+	class FrameBroadcaster
+	{
+	public:
+		//Listen for viewers on a Unix domain socket, anything already at the path is replaced
+		FrameBroadcaster(const std::string& socketPath);
+		//Listen for viewers on a TCP port of localhost
+		FrameBroadcaster(uint16_t port);
+		~FrameBroadcaster();
+
+		FrameBroadcaster(const FrameBroadcaster&) = delete;
+		FrameBroadcaster& operator=(const FrameBroadcaster&) = delete;
+
+		//Take new viewers and send a frame to everyone, height is in characters
+		void Broadcast(const CharPixel* frame, uint16_t width, uint16_t height);
+		//Set how frames are encoded, every viewer gets a keyframe next
+		void SetEncoderSettings(EncoderSettings settings);
+		//Get how frames are encoded
+		EncoderSettings GetEncoderSettings();
+		//Get how many viewers are connected
+		size_t GetViewerCount();
+		//Get how many frames have been skipped for viewers which fell behind, counted once per viewer
+		uint64_t GetSkippedFrames();
+
+		//Bytes a viewer can have waiting before it skips frames
+		size_t maxBacklog = 256 * 1024;
+
+	private:
+#ifdef _WIN32
+		using Socket = SOCKET;
+#else
+		using Socket = int;
+#endif
+
+		//A connected terminal and the encoded frames not yet sent to it
+		struct Viewer
+		{
+			Socket socket;
+			//Frames are shared between every viewer they are queued for
+			std::deque<std::shared_ptr<const std::string>> queue;
+			//Bytes of the first frame in the queue already sent
+			size_t sent = 0;
+			//Bytes in the queue not yet sent
+			size_t backlog = 0;
+			//Only a keyframe can be sent next
+			bool needsKeyframe = true;
+		};
+
+		//Make the listening socket non blocking and start listening, closes it on failure
+		void Listen();
+		//Take every viewer waiting to connect
+		void Accept();
+		//Send as much of a viewer's queue as the socket takes, returns false if the viewer is gone
+		bool Flush(Viewer& viewer);
+		//Close a socket
+		static void CloseSocket(Socket socket);
+
+		Socket listenSocket;
+		std::string socketPath;
+		std::vector<Viewer> viewers;
+
+		//The delta encoder sees every frame, the keyframe encoder only encodes when someone needs it
+		FrameEncoder deltaEncoder;
+		FrameEncoder keyframeEncoder;
+		//Did the last broadcast have any viewers, the delta encoder only follows the frames while it does
+		bool hadViewers = false;
+		uint64_t skippedFrames = 0;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,130 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <cstdint>
+#include <cvid/Types.h>
+#include <cvid/FrameCodec.h>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace cvid
+{
+	//Capture files are a header, then a record for every frame, then an index of the records and a footer
+	//Frames are compressed with FrameCodec, as keyframes every so often and differences to the previous frame otherwise
+	namespace capture
+	{
+		constexpr char magic[8] = { 'C', 'V', 'I', 'D', 'C', 'A', 'P', '1' };
+
+		struct FileHeader
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t reserved;
+		};
+
+		//Followed by size bytes of FrameCodec output
+		struct RecordHeader
+		{
+			//Nanoseconds since the recording started
+			int64_t timestamp;
+			uint32_t size;
+			uint32_t keyframe;
+		};
+
+		struct IndexEntry
+		{
+			//Where the frame's RecordHeader is in the file
+			uint64_t offset;
+			int64_t timestamp;
+		};
+
+		struct Footer
+		{
+			uint64_t indexOffset;
+			uint64_t frameCount;
+			char magic[8];
+		};
+	}
+
+	//Writes frames to a capture file with when each was recorded
+	class FrameRecorder
+	{
+	public:
+		//Start a new capture file, throws if it cannot be created
+		FrameRecorder(const std::string& path);
+		//Finishes the capture file if it was not already
+		~FrameRecorder();
+
+		FrameRecorder(const FrameRecorder&) = delete;
+		FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+		//Add a frame, height is in characters. Returns false if writing failed
+		bool Record(const CharPixel* frame, uint16_t width, uint16_t height);
+		//Write the index and close the file, nothing can be recorded after
+		void Finish();
+		//Get how many frames have been recorded
+		uint64_t GetFrameCount();
+
+		//Frames from one keyframe to the next, replaying from the middle starts at the keyframe before
+		//0 makes only the first frame a keyframe, for the smallest file when replays always start at the beginning
+		uint32_t keyframeInterval = 120;
+
+	private:
+		std::ofstream file;
+		FrameCodec codec;
+		std::vector<capture::IndexEntry> index;
+		std::chrono::steady_clock::time_point start;
+		//Bytes written so far
+		uint64_t offset = 0;
+		bool finished = false;
+	};
+
+	//A capture file mapped into memory for replaying
+	class FrameCapture
+	{
+	public:
+		//Open a capture file, throws if it cannot be opened or is not a capture
+		//Files which were never finished can still be read up to their last whole frame
+		FrameCapture(const std::string& path);
+		~FrameCapture();
+
+		FrameCapture(const FrameCapture&) = delete;
+		FrameCapture& operator=(const FrameCapture&) = delete;
+
+		//Get how many frames there are
+		size_t GetFrameCount();
+		//Get when a frame was recorded in seconds since the start
+		double GetTimestamp(size_t frame);
+		//Decode a frame, width and height are set in characters. Returns nullptr if the frame is broken
+		//Frames are quickest to get in order, any other frame is decoded from the keyframe before it. The frame is valid until the next call
+		const CharPixel* GetFrame(size_t frame, uint16_t& width, uint16_t& height);
+		//Get the size of the file in bytes
+		size_t GetFileSize();
+
+	private:
+		//Get the header of a frame's record and where its data is, returns false if it is outside the file
+		bool GetRecord(size_t frame, capture::RecordHeader& record, const uint8_t*& recordData);
+		//Build the index by walking the records of a file which was never finished
+		void ScanRecords();
+		//Decode one frame on top of the last decoded one
+		const CharPixel* DecodeRecord(size_t frame, uint16_t& width, uint16_t& height);
+		//Unmap and close the file
+		void Unmap();
+
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+		std::vector<capture::IndexEntry> index;
+		FrameCodec codec;
+		//The frame the codec last decoded, SIZE_MAX if none
+		size_t lastDecoded = SIZE_MAX;
+
+#ifdef _WIN32
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = NULL;
+#endif
+	};
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cvid/Types.h>
+
+namespace cvid
+{
+	//Compresses frames sent between processes, either on their own or as the difference to the previous frame
+	//Both ends keep the previous frame, so they have to see the same frames in the same order
+	class FrameCodec
+	{
+	public:
+		//Compress a frame, height is in characters. delta is set if it was compressed against the previous frame
+		//The returned data is valid until the next call
+		const std::vector<uint8_t>& Compress(const CharPixel* frame, uint16_t width, uint16_t height, bool& delta);
+		//Decompress a frame made by Compress, width and height are set in characters
+		//Returns nullptr if the data is broken. The frame is valid until the next call
+		const CharPixel* Decompress(const uint8_t* data, size_t size, bool delta, uint16_t& width, uint16_t& height);
+		//Forget the previous frame so the next one is compressed on its own
+		void Reset();
+		//Get the most bytes Compress can return for a frame of this many character pixels
+		static size_t MaxCompressedSize(size_t pixels);
+
+		//Compress bytes with a fast LZ77 codec, runs of repeating bytes or pixels become single matches
+		static void CompressLZ(const uint8_t* input, size_t size, std::vector<uint8_t>& output);
+		//Decompress bytes made by CompressLZ into exactly outputSize bytes, returns false if the data is broken
+		static bool DecompressLZ(const uint8_t* input, size_t size, uint8_t* output, size_t outputSize);
+
+	private:
+		//Start of every compressed frame
+		struct FrameHeader
+		{
+			uint16_t width;
+			uint16_t height;
+		};
+
+		//The last frame compressed or decompressed, empty if there is none
+		std::vector<CharPixel> previous;
+		uint16_t previousWidth = 0;
+		uint16_t previousHeight = 0;
+
+		//Frame xored with the previous one, only grows
+		std::vector<uint8_t> difference;
+		//Compressed output, only grows
+		std::vector<uint8_t> output;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cvid/Types.h>
+#include <cvid/Palette.h>
+#include <cvid/ThreadPool.h>
+
+namespace cvid
+{
+	//Settings which control how a frame is turned into virtual terminal sequences
+	struct EncoderSettings
+	{
+		//Only send the cells which changed since the last frame, skipping the rest with cursor movement
+		bool deltaFrames = true;
+		//Color depth of the output, palettes take fewer bytes per color change
+		ColorMode colorMode = ColorMode::TrueColor;
+		//Draw half block pixels with whichever of upper half, lower half, full block, or space reuses the current colors
+		bool optimizeGlyphs = true;
+		//Threads encoding bands of rows in parallel, the output is the same for any amount
+		uint16_t numThreads = 1;
+		//Write code page 437 block characters as UTF-8, the Windows console takes them as is but other terminals need this
+#ifdef _WIN32
+		bool utf8Glyphs = false;
+#else
+		bool utf8Glyphs = true;
+#endif
+	};
+
+	//Turns a framebuffer of CharPixels into a string of virtual terminal sequences
+	class FrameEncoder
+	{
+	public:
+		//Encode a frame, height is in characters. The returned string is valid until the next call
+		std::string_view Encode(const CharPixel* frame, uint16_t width, uint16_t height);
+		//Encode a frame into one string per band of rows without joining them. The strings are valid until the next call
+		const std::vector<std::string_view>& EncodeBands(const CharPixel* frame, uint16_t width, uint16_t height);
+		//Forget the last frame so the next one is fully redrawn, call this whenever the console is changed externally
+		void Invalidate();
+
+		EncoderSettings settings;
+
+		//Rows of characters in a band, each band starts with unknown colors so they can be encoded independently
+		static constexpr uint16_t bandRows = 8;
+
+	private:
+		//Everything needed to encode one band of rows
+		struct Band
+		{
+			//The encoded virtual terminal sequences, only grows so steady state frames never allocate
+			std::vector<char> output;
+			size_t length = 0;
+
+			//Colors of the row being encoded in the output color mode, packed rgb for true color or palette indices
+			std::vector<uint32_t> fgKeys;
+			std::vector<uint32_t> bgKeys;
+			//Scratch space for quantizing a row
+			std::vector<Color> rowColors;
+			std::vector<uint8_t> rowIndices;
+
+			//Colors currently set in the console, unknownColor if they have to be set
+			uint32_t currentFg;
+			uint32_t currentBg;
+		};
+
+		//Encode the rows [firstRow, endRow) into a band
+		void EncodeBand(Band& band, const CharPixel* frame, uint16_t width, size_t firstRow, size_t endRow, bool delta) const;
+		//Append every cell of a row
+		char* EncodeFullRow(Band& band, char* out, const CharPixel* row, uint16_t width, size_t y) const;
+		//Append only the cells of a row which differ from the last frame
+		char* EncodeDeltaRow(Band& band, char* out, const CharPixel* row, const CharPixel* lastRow, uint16_t width, size_t y) const;
+		//Convert the colors of a row into the band's fgKeys and bgKeys
+		void ConvertRow(Band& band, const CharPixel* row, uint16_t width) const;
+		//Pick the glyph needing the fewest color changes for a cell, the keys are changed to the colors it needs
+		char ChooseGlyph(const Band& band, char character, uint32_t& fgKey, uint32_t& bgKey) const;
+		//Append one cell, changing colors if needed
+		char* AppendCell(Band& band, char* out, char character, uint32_t fgKey, uint32_t bgKey) const;
+		//Append a character, converting it to UTF-8 if needed
+		char* AppendCharacter(char* out, char character) const;
+		//Append the SGR parameters to set a color
+		char* AppendColor(char* out, uint32_t key, bool background) const;
+
+		std::vector<Band> bands;
+		//The encoded output of each band
+		std::vector<std::string_view> bandOutputs;
+		//Every band joined together, only grows
+		std::vector<char> output;
+		//Only created when encoding with more than one thread
+		std::unique_ptr<ThreadPool> threadPool;
+
+		//Copy of the last encoded frame, accessed [y * width + x]
+		std::vector<CharPixel> lastFrame;
+		uint16_t lastWidth = 0;
+		uint16_t lastHeight = 0;
+		//Does lastFrame match what is in the console
+		bool lastFrameValid = false;
+	};
+}
\ No newline at end of file
@@ -8,4 +8,8 @@ namespace cvid
 	std::vector<double> LerpRange(int start, int end, double a, double b);
 	//Linearly interpolate Vector2 values for each step between start and end (both inclusive)
 	std::vector<Vector2> LerpRange2D(int start, int end, Vector2 a, Vector2 b);
+	//Linearly interpolate values for each step between start and end (both inclusive) into values, replacing what it had
+	void LerpRange(int start, int end, double a, double b, std::vector<double>& values);
+	//Linearly interpolate Vector2 values for each step between start and end (both inclusive) into values, replacing what it had
+	void LerpRange2D(int start, int end, Vector2 a, Vector2 b, std::vector<Vector2>& values);
 }
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+#include <cvid/Types.h>
+
+namespace cvid
+{
+	//Color depths the console can be drawn with
+	enum class ColorMode : uint8_t { TrueColor = 0, Palette256 = 1, Palette16 = 2 };
+
+	//Get the rgb value of a palette index, 16 color palette uses the Windows console defaults
+	Color PaletteColor(uint8_t index, ColorMode mode);
+	//Find the closest palette index of a color in O(1) using a lookup table
+	uint8_t QuantizeColor(Color color, ColorMode mode);
+	//Find the closest palette index for each color in an array, vectorized where available
+	void QuantizeColors(const Color* colors, size_t count, ColorMode mode, uint8_t* indices);
+}
\ No newline at end of file
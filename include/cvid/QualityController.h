@@ -0,0 +1,90 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cvid/Window.h>
+
+namespace cvid
+{
+	//The quality knobs a QualityController turns
+	struct QualitySettings
+	{
+		//Color depth of the output, palettes take fewer bytes per color change
+		ColorMode colorMode = ColorMode::TrueColor;
+		//Console pixels per rendered pixel
+		uint16_t renderScale = 1;
+		//Sample textures per pixel instead of using their average color
+		bool textureSampling = true;
+	};
+
+	//Lowers and raises the quality of a window to keep the frame rate near a target
+	//Render time and present time are measured separately so the knob for whichever is slower gets turned first
+	class QualityController
+	{
+	public:
+		QualityController(Window* window, double targetFps = 30);
+
+		//Call before drawing anything for a frame
+		void BeginFrame();
+		//Call right before DrawFrame
+		void BeginPresent();
+		//Call after DrawFrame, changes the quality if the frame rate has been off for long enough
+		void EndFrame();
+
+		//Get the settings currently in use
+		QualitySettings GetSettings();
+		//Get how far down from full quality the settings are, 0 is full quality
+		int GetLevel();
+		//Get the average render time in seconds over the last measurement period
+		double GetRenderTime();
+		//Get the average present time in seconds over the last measurement period
+		double GetPresentTime();
+		//Get a short description of the current settings for displaying
+		std::string Describe();
+
+		//The frame rate to keep
+		double targetFps;
+		//Quality is only raised if frames take less than this fraction of the frame budget
+		double headroom = 0.7;
+		//Seconds of frames averaged before each decision
+		double measurePeriod = 0.5;
+		//Enable automatic changes, the settings stay as they are when disabled
+		bool enabled = true;
+
+	private:
+		//Steps which lower the quality, they are undone in reverse order
+		enum class Step : uint8_t { Palette256, Palette16, NoTextures, HalfResolution };
+
+		//Lower the quality by one step, returns false if there is nothing left to lower
+		bool Lower(bool presentBound);
+		//Undo the last step
+		void Raise();
+		//Apply the current settings to the window and rasterizer
+		void Apply();
+
+		Window* window;
+		QualitySettings settings;
+		//Steps taken so far, the last one is undone first
+		std::vector<Step> steps;
+
+		using Clock = std::chrono::steady_clock;
+		Clock::time_point frameStart;
+		Clock::time_point presentStart;
+		Clock::time_point periodStart;
+
+		//Totals over the current measurement period
+		double totalFrameTime = 0;
+		double totalRenderTime = 0;
+		double totalPresentTime = 0;
+		int periodFrames = 0;
+
+		//Averages of the last measurement period
+		double renderTime = 0;
+		double presentTime = 0;
+
+		//Seconds to wait before trying to raise the quality, doubles every time a raise has to be undone
+		double raiseDelay = 0;
+		double timeSinceChange = 0;
+		bool lastChangeWasRaise = false;
+	};
+}
\ No newline at end of file
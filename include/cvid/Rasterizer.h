@@ -7,6 +7,15 @@
 
 namespace cvid
 {
+	//How triangles are filled, both draw the same pixels from the triangle's fixed point edge functions with a top-left fill rule
+	enum class RasterMode : uint8_t
+	{
+		//Walk each row between where the left and right edges cross it
+		Scanline = 0,
+		//Test 8x8 tiles of pixels against the edge functions, accepting or rejecting a whole tile at once where it can
+		Tiled = 1
+	};
+
 	//A struct to store vertex attributes
 	struct Attributes
 	{
@@ -25,10 +34,24 @@ namespace cvid
 	void RasterizeLine(Window* window, Vector3 v0, Vector3 v1, Color color);
 	//Interpolate vertex attributes for each position between start and end (inclusive), left or right edge is prioritized
 	std::vector<Attributes> InterpolateAttributes(Vector2Int start, Vector2Int end, Attributes a, Attributes b, bool prioritizeLeft = false);
+	//Interpolate vertex attributes for each position between start and end (inclusive) into results, replacing what it had
+	void InterpolateAttributes(Vector2Int start, Vector2Int end, Attributes a, Attributes b, bool prioritizeLeft, std::vector<Attributes>& results);
 	//Draw a triangle onto a window's framebuffer based on a material and attributes
 	void RasterizeTriangle(Window* window, Face triangle, const Material* mat = nullptr);
+	//Draw the part of a triangle inside clip, which must be inside the window. Pixels come out the same as drawing all of it
+	void RasterizeTriangle(Window* window, Face triangle, const Material* mat, PixelRect clip);
 	//Draw a triangle onto a window's framebuffer entirely of one color
 	void RasterizeTriangle(Window* window, Tri verts, Color color);
+	//Draw the part of a triangle entirely of one color inside clip, which must be inside the window
+	void RasterizeTriangle(Window* window, Tri verts, Color color, PixelRect clip);
+	//Get what a face is shaded with under the current lights and texture sampling setting
+	VisibleFace LightFace(const Face& face, const Material* mat);
+	//Store id in the window's visibility buffer for the pixels of a triangle inside clip which pass the depth test, the colors are left as they are
+	void RasterizeTriangleVisibility(Window* window, Tri verts, uint32_t id, PixelRect clip);
+	//Make room in this thread's scratch for ShadeVisibility to set up some amount of faces, so shading them does not allocate
+	void ReserveShadeVisibility(size_t numFaces);
+	//Shade the rows from minY to maxY of a window's visibility buffer, each pixel once with the face stored there
+	void ShadeVisibility(Window* window, int minY, int maxY);
 	//Draw a triangle onto a window's framebuffer
 	void RasterizeTriangleWireframe(Window* window, Tri verts, Color color);
 		
@@ -37,4 +60,8 @@ namespace cvid
 	inline double directionalLightIntensity = 0;
 	//The ambient light in the scene from 0-1
 	inline double ambientLightIntensity = 1;
+	//Sample textures per pixel, otherwise textured triangles use the average color of their texture
+	inline bool enableTextureSampling = true;
+	//How RasterizeTriangle fills triangles, can be changed at any time
+	inline RasterMode rasterMode = RasterMode::Scanline;
 }
\ No newline at end of file
@@ -18,6 +18,17 @@ namespace cvid
 	//Render a model's vertices as wireframe to the window's framebuffer
 	void DrawModelWireframe(ModelInstance* model, Camera* cam, Window* window);
 
+	//Shade every pixel the window's visibility buffer holds once, with the face stored there. Clears the visibility buffer
+	//Call after drawing every model of a frame with deferredShading, before drawing anything else on top
+	void ShadeDeferred(Window* window);
+
+	//Make DrawModel only store the depth and the face in front at each pixel, ShadeDeferred then textures and lights each pixel once
+	//Shading no longer pays for overdraw, and the frame is the same as drawing without it
+	inline bool deferredShading = false;
+	//Threads DrawModel rasterizes on, the faces are sorted into bands of rows which are drawn in parallel
+	//The output is the same for any amount, with 1 every face is drawn straight away on the calling thread
+	inline uint16_t rasterThreads = 1;
+
 	//Utility Functions
 	//Returns 0 if a model falls entirely outside a camera's clip space, 1 if it's entirely inside, and >1 if it falls in between
 	//If >1 the intersected planes can be acquired by checking each bit corresponding to a plane: 1 = near, 2 = left, 3 = right, 4 = bottom, and 5 = top
@@ -25,6 +36,8 @@ namespace cvid
 	//Returns a vector with 0, 1, or more triangles clipped against every specified plane
 	//Planes are determined by checking the corresponding bit: 1 = near, 2 = left, 3 = right, 4 = bottom, and 5 = top
 	std::vector<Face> ClipFace(const Face& triangle, Camera* cam, std::bitset<8> planes = 0b11111111);
+	//Clip a triangle against every specified plane into clippedTris, replacing what it had
+	void ClipFace(const Face& triangle, Camera* cam, std::bitset<8> planes, std::vector<Face>& clippedTris);
 	//Clips a line against every specified camera clip plane
 	//Planes are determined by checking the corresponding bit: 1 = near, 2 = left, 3 = right, 4 = bottom, and 5 = top
 	std::pair<Vector3, Vector3> ClipSegment(Vector3 p1, Vector3 p2, Camera* cam, std::bitset<8> planes = 0b11111111);
@@ -0,0 +1,80 @@
+#pragma once
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <cvid/Types.h>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace cvid
+{
+	//A ring of framebuffers in memory shared between two processes
+	//One process writes frames into it and tells the other their sequence numbers, which it reads them by
+	class SharedFrameRing
+	{
+	public:
+		//Create a new shared ring with slots for frames of up to maxPixels character pixels
+		SharedFrameRing(const std::string& name, size_t maxPixels, uint32_t slotCount = 3);
+		//Open a ring created by another process
+		SharedFrameRing(const std::string& name);
+		~SharedFrameRing();
+
+		SharedFrameRing(const SharedFrameRing&) = delete;
+		SharedFrameRing& operator=(const SharedFrameRing&) = delete;
+
+		//Copy a frame into the next free slot, height is in characters
+		//Returns the frame's sequence number, or 0 if the frame is too big or the reader has not released any slot
+		uint64_t Write(const CharPixel* frame, uint16_t width, uint16_t height);
+		//Get a frame by sequence number, height is in characters. Returns nullptr if the slot holds a different frame
+		//The frame is valid until it is released
+		const CharPixel* Read(uint64_t sequence, uint16_t& width, uint16_t& height);
+		//Let the writer reuse the slots of every frame up to and including sequence
+		void Release(uint64_t sequence);
+
+		//Get the name other processes open the ring by
+		const std::string& GetName();
+		//Get the most character pixels a frame can have
+		size_t GetMaxPixels();
+
+	private:
+		//Start of the shared memory
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t slotCount;
+			uint64_t slotPixels;
+			uint64_t slotStride;
+			//Sequence number of the last written frame, sequence numbers start at 1
+			std::atomic<uint64_t> written;
+			//Sequence number of the last frame the reader is done with
+			std::atomic<uint64_t> released;
+		};
+		//Start of each slot, followed by the pixels
+		struct alignas(64) Slot
+		{
+			//Which frame the slot holds, set after the pixels are written
+			std::atomic<uint64_t> sequence;
+			uint16_t width;
+			uint16_t height;
+		};
+
+		//Map the shared memory, creating it if size is not 0
+		void Map(size_t size);
+		//Get a slot by sequence number
+		Slot* GetSlot(uint64_t sequence);
+
+		std::string name;
+		Header* header = nullptr;
+		size_t mappingSize = 0;
+		//Did this process create the ring
+		bool owner = false;
+
+#ifdef _WIN32
+		HANDLE mapping = NULL;
+#else
+		int fd = -1;
+#endif
+	};
+}
\ No newline at end of file
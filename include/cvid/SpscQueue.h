@@ -0,0 +1,88 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+namespace cvid
+{
+	//A fixed size queue between one producer thread and one consumer thread
+	//Items stay in their slots and are reused, so items which own memory only allocate while growing
+	template<typename T>
+	class SpscQueue
+	{
+	public:
+		SpscQueue(size_t capacity) : slots(capacity)
+		{
+		}
+
+		//Producer: get the slot to fill next, waits while the queue is full. Returns nullptr once closed
+		T* BeginPush()
+		{
+			size_t t = tail.load(std::memory_order_relaxed) & ~closedBit;
+			while (true)
+			{
+				size_t h = head.load(std::memory_order_acquire);
+				if (h & closedBit)
+					return nullptr;
+				if (t - h < slots.size())
+					return &slots[t % slots.size()];
+				head.wait(h, std::memory_order_acquire);
+			}
+		}
+		//Producer: hand the filled slot to the consumer
+		void EndPush()
+		{
+			tail.fetch_add(1, std::memory_order_release);
+			tail.notify_one();
+		}
+
+		//Consumer: get the oldest item, waits while the queue is empty. Returns nullptr once closed and empty
+		T* Front()
+		{
+			size_t h = head.load(std::memory_order_relaxed) & ~closedBit;
+			while (true)
+			{
+				size_t t = tail.load(std::memory_order_acquire);
+				if ((t & ~closedBit) != h)
+					return &slots[h % slots.size()];
+				if (t & closedBit)
+					return nullptr;
+				tail.wait(t, std::memory_order_acquire);
+			}
+		}
+		//Consumer: get the item after the front one without waiting, nullptr if there is none yet
+		T* PeekNext()
+		{
+			size_t h = head.load(std::memory_order_relaxed) & ~closedBit;
+			size_t t = tail.load(std::memory_order_acquire) & ~closedBit;
+			if (t - h < 2)
+				return nullptr;
+			return &slots[(h + 1) % slots.size()];
+		}
+		//Consumer: done with the front item, its slot can be filled again
+		void Pop()
+		{
+			head.fetch_add(1, std::memory_order_release);
+			head.notify_one();
+		}
+
+		//Make both sides stop waiting, the producer can not push anymore and the consumer gets what is left
+		void Close()
+		{
+			head.fetch_or(closedBit, std::memory_order_release);
+			tail.fetch_or(closedBit, std::memory_order_release);
+			head.notify_all();
+			tail.notify_all();
+		}
+
+	private:
+		//Set in both counters once closed, changing them wakes anyone waiting on either
+		static constexpr size_t closedBit = (size_t)1 << (sizeof(size_t) * 8 - 1);
+
+		std::vector<T> slots;
+		//Next slot to pop, only the consumer moves it
+		alignas(64) std::atomic<size_t> head = 0;
+		//Next slot to push, only the producer moves it
+		alignas(64) std::atomic<size_t> tail = 0;
+	};
+}
\ No newline at end of file
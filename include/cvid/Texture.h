@@ -23,5 +23,7 @@ namespace cvid
 		int height = 0;
 		//Pixel data, accessed [y * width + x] 
 		std::vector<Color> data;
+		//Average of every pixel, used in place of sampling when texture sampling is disabled
+		Color averageColor;
 	};
 }
\ No newline at end of file
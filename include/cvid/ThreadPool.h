@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+namespace cvid
+{
+	//A fixed set of worker threads for splitting loops across cores
+	class ThreadPool
+	{
+	public:
+		//Create a pool with some amount of worker threads, the calling thread also works so this can be 0
+		ThreadPool(size_t numWorkers);
+		~ThreadPool();
+
+		//Run job(i) for every i in [0, count) on the workers and the calling thread, returns once all are done
+		void ParallelFor(size_t count, const std::function<void(size_t)>& job);
+		//Run job once on every worker and the calling thread, for setting up thread local state. Returns once all are done
+		void ForEachThread(const std::function<void()>& job);
+		//Get how many threads work on a job, including the calling thread
+		size_t GetThreadCount();
+
+	private:
+		//Hand a job to every worker and wait until they are all done with it, the calling thread runs work in between
+		void RunOnWorkers(const std::function<void(size_t)>* loopJob, size_t count, const std::function<void()>* threadJob, const std::function<void()>& work);
+		//Wait for jobs and work on them until the pool is destroyed
+		void WorkerLoop();
+		//Take indices from the current job until there are none left
+		void WorkOnJob();
+
+		std::vector<std::thread> workers;
+
+		//Guards everything below except the atomics
+		std::mutex mutex;
+		std::condition_variable jobStarted;
+		std::condition_variable jobFinished;
+		//The current job, only valid while a ParallelFor is running. threadJob instead while a ForEachThread is
+		const std::function<void(size_t)>* job = nullptr;
+		const std::function<void()>* threadJob = nullptr;
+		size_t jobCount = 0;
+		//Incremented for every job so workers know when there is a new one
+		uint64_t jobGeneration = 0;
+		//Workers which have not finished the current job yet
+		size_t busyWorkers = 0;
+		bool stopping = false;
+
+		//Next index of the current job to hand out
+		std::atomic<size_t> nextIndex = 0;
+	};
+}
\ No newline at end of file
@@ -4,6 +4,8 @@
 
 namespace cvid
 {
+	class Texture;
+
 	struct Sphere
 	{
 		//Center point in world space
@@ -39,6 +41,15 @@ namespace cvid
 		uint8_t a = 255;
 	};
 
+	//A rectangle of render pixels, both corners are inclusive
+	struct PixelRect
+	{
+		int minX;
+		int minY;
+		int maxX;
+		int maxY;
+	};
+
 	//A face (triangle) that uses it's own texture coords and vertices
 	struct Face
 	{
@@ -47,10 +58,30 @@ namespace cvid
 		Vector3 normal;
 	};
 
+	//A face in screen space drawn into a window's visibility buffer, with what it is shaded with once the frame is drawn
+	struct VisibleFace
+	{
+		Face face;
+		//Null for flat shading
+		Texture* texture = nullptr;
+		Color color;
+		double intensity = 1;
+	};
+
 	//A face (triangle) that used indexed texture coords and vertices
 	struct IndexedFace
 	{
 		std::array<uint32_t, 3> verticeIndices = {};
 		std::array<uint32_t, 3> texCoordIndices = {};
 	};
+
+	//Ascii representation of two vertically stacked pixels
+	struct CharPixel
+	{
+		//Top pixel color
+		Color fg;
+		//Bottom pixel color
+		Color bg;
+		char character = (char)223;
+	};
 }
\ No newline at end of file
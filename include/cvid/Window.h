@@ -3,16 +3,40 @@
 #include <string>
 #include <functional>
 #include <unordered_map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <string_view>
+#ifdef _WIN32
 #define NOMINMAX
 #include <windows.h>
+#else
+#include <termios.h>
+#include <signal.h>
+#include <sys/types.h>
+#endif
 #include <cvid/Vector.h>
 #include <cvid/Types.h>
+#include <cvid/FrameEncoder.h>
+#include <cvid/SharedFrameRing.h>
+#include <cvid/FrameCodec.h>
+#include <cvid/FrameBroadcaster.h>
+#include <cvid/FrameCapture.h>
 
 namespace cvid
 {
-	//Get the maximum size of a cmd window
+	//Get the maximum size of a cmd window, or the size of the terminal on POSIX
 	Vector2Int MaxWindowSize();
 
+	//Exit code of a window process
+#ifdef _WIN32
+	using ExitCode = DWORD;
+#else
+	using ExitCode = int;
+#endif
+
 	//Properties of the console window which cannot be controlled by vts
 	struct WindowProperties
 	{
@@ -20,17 +44,61 @@ namespace cvid
 		uint16_t height;
 	};
 
+	//Sent to the window process ahead of the pixels of every frame
+	struct FrameInfo
+	{
+		//Counts up from 1 for every frame sent
+		uint64_t sequence;
+		//When the frame was sent in steady clock nanoseconds
+		int64_t timestamp;
+	};
+
+	//Sent back by the window process after each message, which lets another one be sent
+	struct FrameStatus
+	{
+		//The FrameInfo of the frame handled, 0 for other messages
+		uint64_t sequence;
+		int64_t timestamp;
+		//False if the frame was skipped because a newer one was already waiting
+		bool presented;
+	};
+
 	//Is the data a frame string or properties struct
-	enum class DataType : uint8_t { String = 1, Properties = 2, Frame = 3, Ready = 4 };
+	enum class DataType : uint8_t { String = 1, Properties = 2, Frame = 3, Ready = 4, EncoderSettings = 5, SharedRing = 6, SharedFrame = 7, CompressedFrame = 8, DeltaFrame = 9 };
+
+	//How DrawFrame hands frames over to the console
+	enum class PresentMode : uint8_t
+	{
+		//Encode and write the frame before DrawFrame returns
+		Synchronous = 0,
+		//A present thread draws frames in the background, only the newest waiting frame is kept
+		LatestFrame = 1,
+		//A present thread draws every frame in the background, DrawFrame waits if too many are queued
+		Queued = 2
+	};
+
+	//Where a window draws its frames
+	enum class WindowMode : uint8_t
+	{
+		//Use the console of the main application
+		Main = 0,
+		//Open a ConsoleWindowApp process, in a terminal emulator on Linux and macOS
+		NewProcess = 1,
+		//Keep frames in memory only, encoded frames go to outputSink if it is set
+		Headless = 2
+	};
 
-	//Ascii representation of two vertically stacked pixels
-	struct CharPixel
+	//How the depth buffer stores the depth of each pixel
+	enum class DepthFormat : uint8_t
 	{
-		//Top pixel color
-		Color fg;
-		//Bottom pixel color
-		Color bg;
-		char character = (char)223;
+		//Distance as a double, a pixel is drawn unless it is more than 0.5 further away than the one there
+		Float64 = 0,
+		//Inverse distance as a float, pixels as near or nearer than the one there are drawn. Half the memory of Float64
+		Float32Reversed = 1,
+		//Inverse distance in 24 bit fixed point stored in 32 bits, largest at Window::fixedDepthNear. Half the memory of Float64
+		Fixed24 = 2,
+		//Inverse distance in 16 bit fixed point, largest at Window::fixedDepthNear. A quarter of the memory of Float64
+		Fixed16 = 3
 	};
 
 	//How many windows have ever been created
@@ -42,6 +110,8 @@ namespace cvid
 	public:
 		//Create a new console window with dimensions in console pixels
 		Window(uint16_t width, uint16_t height, std::string name, bool newProcess = false);
+		//Create a new window with dimensions in console pixels
+		Window(uint16_t width, uint16_t height, std::string name, WindowMode mode);
 		~Window();
 
 		//Set a pixel on the framebuffer to some color, returns true on success
@@ -52,6 +122,10 @@ namespace cvid
 		bool PutPixel(Vector2Int pos, Color color, double z);
 		//Set a pixel on the framebuffer to some color, implements depth buffer, returns true on success
 		bool PutPixel(uint16_t x, uint16_t y, Color color, double z);
+		//Set a row of count pixels starting at x, y to colors, implements depth buffer like PutPixel, returns how many were set
+		int PutSpan(int x, int y, int count, const Color* colors, const double* depths);
+		//Store id in the visibility buffer for a row of pixels instead of colors, with the same depth test as PutSpan, returns how many were set
+		int PutVisibilitySpan(int x, int y, int count, uint32_t id, const double* depths);
 		//Put a character on the framebuffer, in this case y is half
 		bool PutChar(Vector2Int pos, CharPixel charPixel);
 		//Put a character on the framebuffer, in this case y is half
@@ -62,33 +136,112 @@ namespace cvid
 		bool PutString(uint16_t x, uint16_t y, std::string string, Color bg = { 12, 12, 12 }, Color fg = { 204, 204, 204 });
 		//Fills the framebuffer with a color
 		bool Fill(Color color);
-		//Clear the depthbuffer, setting everything to 0
+		//Clear the depth buffer so nothing is in front of any pixel, DrawFrame also does this. Also clears the visibility buffer
 		bool ClearDepthBuffer();
-		//Get a modifiable reference to the depth buffer bit of a pixel
+		//Add a face to shade the pixels of later, returns the id to put in the visibility buffer for it
+		uint32_t AddVisibleFace(const VisibleFace& face);
+		//Make room for some more faces to be added, so adding them does not allocate
+		void ReserveVisibleFaces(size_t count);
+		//Get the faces added since the visibility buffer was last cleared, id 1 is the first
+		const std::vector<VisibleFace>& GetVisibleFaces();
+		//Get a row of render pixels of the visibility buffer, 0 where no face is stored. Null if nothing has been put in it
+		const uint32_t* GetVisibilityRow(uint16_t y);
+		//Forget the faces and the visibility buffer, the depth buffer is kept
+		void ClearVisibility();
+		//Get a modifiable reference to the depth buffer bit of a pixel in render coordinates, only with the Float64 format
 		double* GetDepthBufferBit(uint16_t x, uint16_t y);
+		//Get the distance stored in the depth buffer for a pixel in render coordinates, infinity if nothing has been drawn there
+		double GetDepth(uint16_t x, uint16_t y);
+		//Set how the depth buffer stores depth, clears the depth buffer
+		void SetDepthFormat(DepthFormat format);
+		//Get how the depth buffer stores depth
+		DepthFormat GetDepthFormat();
+		//Would anything in a rectangle of render pixels no nearer than nearest fail the depth test everywhere
+		//Always false unless occlusion culling is enabled and the depth format is a reversed one
+		bool IsOccluded(PixelRect rect, double nearest);
+		//Refresh the depths occlusion culling tests against for a rectangle of render pixels, DrawModel does this after drawing
+		void UpdateOcclusion(PixelRect rect);
 		//Draw the current framebuffer
 		bool DrawFrame();
 		//Send some arbitrary data to the window
 		bool SendData(const void* data, size_t amount, DataType type, bool block = true);
 		//Set the properties of this window, clears the framebuffer
 		bool Resize(int16_t w, int16_t h);
+		//Set how frames are encoded into virtual terminal sequences
+		bool SetEncoderSettings(EncoderSettings settings);
+		//Get how frames are encoded into virtual terminal sequences
+		EncoderSettings GetEncoderSettings();
+		//Set how frames are presented, queueDepth is the most frames waiting in Queued mode
+		void SetPresentMode(PresentMode mode, size_t queueDepth = 2);
+		//Get how frames are presented
+		PresentMode GetPresentMode();
+		//Get how long encoding and writing the last frame took in seconds, measured on whichever thread presented it
+		double GetPresentTime();
+		//Get how long the single write of the last frame took in seconds
+		double GetWriteTime();
+		//Does the console support synchronized output, asked once when the window is created
+		bool SupportsSynchronizedOutput();
+		//Get how long after being sent the last frame the window process drew took to draw, in seconds
+		double GetViewerLag();
+		//Get how many frames the window process skipped because a newer one was already waiting
+		uint64_t GetDroppedFrames();
+		//Record every presented frame to a capture file for replaying, ends any recording in progress. Returns false if the file could not be created
+		bool StartRecording(const std::string& path);
+		//Finish the recording in progress
+		void StopRecording();
+		//Set how many console pixels wide and tall each pixel drawn with PutPixel is, lower resolution renders faster
+		void SetRenderScale(uint16_t scale);
+		//Get how many console pixels wide and tall each pixel drawn with PutPixel is
+		uint16_t GetRenderScale();
+		//Get the size PutPixel and the depth buffer work in, the window size divided by the render scale
+		Vector2Int GetRenderSize();
 		//Closes the window process
 		void CloseWindow();
 		//Return true if the window process is still active, optionally gives back exit code
-		bool IsAlive(DWORD* exitCode = nullptr);
+		bool IsAlive(ExitCode* exitCode = nullptr);
+#ifdef _WIN32
 		//Get the input record of this console window
 		std::vector<INPUT_RECORD> GetInputRecord();
+#else
+		//Get the bytes typed into the terminal since the last call, never blocks
+		std::string GetInput();
+#endif
 		//Get the dimensions of this window. Y is in pixel coordinates
 		Vector2Int GetSize();
+		//Get the color a pixel of the framebuffer is shown as
+		Color GetPixel(uint16_t x, uint16_t y);
+		//Save the framebuffer as it is shown to a binary PPM image, returns true on success
+		bool SaveFrame(const std::string& path);
+		//Get a hash of the framebuffer as it is shown, equal frames have equal hashes
+		uint64_t HashFrame();
 
 		//Function to call when the window closes
 		std::function<void(Window*)> onClose;
 		//Enable depth buffering
 		bool enableDepthTest = true;
+		//Distance the fixed point depth formats are most precise at, anything nearer gets the same depth
+		double fixedDepthNear = 1;
+		//Let DrawModel skip models and faces hidden behind what has already been drawn, only with a reversed depth format
+		//The output is the same either way. Drawing with anything else is only taken into account after UpdateOcclusion
+		bool enableOcclusionCulling = true;
+		//Wrap frames in synchronized output if the console supports it, so a frame is never shown half drawn
+		bool enableSynchronizedOutput = true;
+		//Headless only, gets each encoded frame in pieces
+		std::function<void(std::string_view)> outputSink;
+		//Messages sent to the window process before waiting for it to handle one, it only draws the newest waiting frame
+		uint16_t maxFramesInFlight = 3;
+		//Also sends every presented frame to the viewers of this, from whichever thread presents. Use a headless window to only broadcast
+		FrameBroadcaster* broadcaster = nullptr;
 
+#ifdef _WIN32
 		//Handle to the console input and output of this window
 		HANDLE consoleOut;
 		HANDLE consoleIn;
+#else
+		//File descriptors of the terminal input and output of this window
+		int terminalOut = -1;
+		int terminalIn = -1;
+#endif
 	private:
 		//Create this window as a new process
 		void CreateAsNewProcess(std::string name);
@@ -97,27 +250,156 @@ namespace cvid
 
 		//Resize the console to fit the frame
 		void ResizeMain(int16_t w, int16_t h);
+		//Write some strings to the console, or outputSink if headless, must hold outputMutex
+		bool WriteOutput(const std::vector<std::string_view>& parts);
+		//Write some strings to the console in order, must hold outputMutex
+		bool WriteToConsole(const std::vector<std::string_view>& parts);
+		//Restore the console or end the window process
+		void CloseConsole();
+		//Has the console been changed externally since the last call, must hold outputMutex
+		bool ConsoleChanged();
+		//Ask the console if it supports synchronized output, waits for the reply up to a timeout
+		void QuerySynchronizedOutput();
+		//Look for the replies to synchronizedOutputQuery, returns true once the answer is known
+		bool ParseSynchronizedOutputReply(std::string_view reply);
+
+		//Report DEC mode 2026 (synchronized output), then primary device attributes which every terminal answers
+		static constexpr std::string_view synchronizedOutputQuery = "\x1b[?2026$p\x1b[c";
+		//Longest wait for the console to reply to synchronizedOutputQuery in milliseconds
+		static constexpr int synchronizedOutputTimeout = 200;
+
+		//Encode and write a frame to the console, height is in pixels
+		bool PresentFrame(const CharPixel* frame, uint16_t w, uint16_t h);
+		//Encode and write a frame to the console or window process, height is in pixels
+		bool EncodeAndWrite(const CharPixel* frame, uint16_t w, uint16_t h);
+		//Create the shared memory frames are sent to the window process through and tell it about it
+		void CreateFrameRing(const std::string& ringName);
+		//Send a frame to the window process with its sequence number and the time
+		bool SendFrame(const void* data, size_t amount, DataType type);
+		//Handle the statuses the window process has sent, waiting for one first if wait is set
+		bool ReadStatus(bool wait);
+		//Present queued frames until stopped
+		void PresentLoop();
+		//Stop the present thread after it has drawn every queued frame
+		void StopPresentThread();
+
+		//Set a pixel of the framebuffer in console pixels, must be in bounds
+		void SetConsolePixel(uint16_t x, uint16_t y, Color color);
+		//Set the block of console pixels covered by a render pixel, must be in bounds
+		void SetRenderPixel(uint16_t x, uint16_t y, Color color);
+		//Set the console pixel or block of them a render pixel covers, scaled is whether the render scale is above 1
+		template<bool scaled>
+		void SetSpanPixel(uint16_t x, uint16_t y, Color color);
+		//Set a row of pixels inside the window, PutSpan picks the variant for the depth test, depth format, and render scale
+		template<bool depthTest, DepthFormat format, bool scaled>
+		int PutClippedSpan(int x, int y, int count, const Color* colors, const double* depths);
+		//Test a depth against the depth buffer at an index and store it if it is in front, the depth test must be enabled
+		bool TestDepth(size_t index, double z);
+		//Test a depth against the depth buffer at an index in a known format and store it if it is in front
+		template<DepthFormat format>
+		bool TestDepth(size_t index, double z);
+		//Inverse depth of a distance as a reversed depth format stores it
+		double ReversedDepth(double z);
+		//Recalculate the render size after the window size or render scale changed
+		void UpdateRenderSize();
 
 		//Bitmap of each character pixel for the window
 		//Half the screen height and upside down, accessed [(height - 1 - y) / 2 * width + x] 
 		CharPixel* frameBuffer;
 
-		//Depth buffer for current z of every pixel 
+		//Depth buffer for current z of every pixel, in depthFormat
 		//Full screen height, accessed [y * width + x]
-		double* depthBuffer;
+		uint8_t* depthBuffer;
+		DepthFormat depthFormat = DepthFormat::Float64;
+
+		//Render pixels in each direction of an occlusion tile, and tiles in each direction of a block
+		static constexpr int occlusionTileSize = 8;
+		static constexpr int occlusionBlockSize = 8;
+		//Smallest inverse depth of each tile of the depth buffer, and of each block of tiles, with a reversed format
+		//Anything with a smaller inverse depth, so further away, fails the depth test everywhere in the tile or block
+		std::vector<double> occlusionTiles;
+		std::vector<double> occlusionBlocks;
+		int occlusionTilesX = 0;
+		int occlusionBlocksX = 0;
+
+		//The id of the face in visibleFaces in front at each render pixel, accessed [y * renderWidth + x]
+		//Only allocated once something is put in it
+		std::vector<uint32_t> visibilityBuffer;
+		std::vector<VisibleFace> visibleFaces;
+
+		//Turns the framebuffer into virtual terminal sequences, only used when drawing directly
+		FrameEncoder encoder;
+		//Held while writing to the console or pipe, and while using the encoder
+		std::mutex outputMutex;
+
+		//A copy of the framebuffer waiting to be presented
+		struct QueuedFrame
+		{
+			std::vector<CharPixel> pixels;
+			uint16_t width = 0;
+			uint16_t height = 0;
+		};
+
+		//PRESENT THREAD SPECIFIC
+		PresentMode presentMode = PresentMode::Synchronous;
+		size_t presentQueueDepth = 2;
+		std::thread presentThread;
+		//Guards everything below
+		std::mutex presentMutex;
+		std::condition_variable presentCondition;
+		//Frames waiting to be presented, oldest first
+		std::deque<QueuedFrame> presentQueue;
+		//Already presented frames kept to avoid reallocating
+		std::vector<QueuedFrame> freeFrames;
+		bool stopPresenting = false;
+		//Is the present thread sending a frame it took from the queue
+		bool presenting = false;
+		//Did the last frame from the present thread fail
+		std::atomic<bool> presentFailed = false;
+		//Seconds the last PresentFrame took
+		std::atomic<double> presentTime = 0;
+		//Seconds the write of the last frame took
+		std::atomic<double> writeTime = 0;
+		//Did the console say it supports synchronized output
+		bool synchronizedOutput = false;
+		//A frame with the synchronized output begin and end around it, only grows
+		std::vector<std::string_view> frameParts;
 
 		//Window properties
 		std::string name;
 		uint16_t width;
 		uint16_t height;
-		bool alive = true;
+		std::atomic<bool> alive = true;
 		//Is this window it's own process or the console of the parent application
 		bool seperateProcess;
+		//Frames for the window process, only sequence numbers go through the pipe. Null if it could not be created
+		std::unique_ptr<SharedFrameRing> frameRing;
+		//Compresses frames which go through the pipe, the window process keeps the same previous frame
+		FrameCodec frameCodec;
+		//Gets every presented frame while recording
+		std::unique_ptr<FrameRecorder> recorder;
+		std::mutex recordMutex;
+		//Sequence number of the last frame sent to the window process
+		uint64_t frameSequence = 0;
+		//A frame with its FrameInfo in front, only grows
+		std::vector<char> frameMessage;
+		//Messages sent to the window process which it has not sent a status for yet
+		uint32_t messagesInFlight = 0;
+		//Seconds from sending to drawing the last frame the window process drew
+		std::atomic<double> viewerLag = 0;
+		std::atomic<uint64_t> droppedFrames = 0;
+		//Is this window only in memory
+		bool headless;
+		//Console pixels per render pixel in each direction, and the resulting size PutPixel works in
+		uint16_t renderScale = 1;
+		uint16_t renderWidth = 0;
+		uint16_t renderHeight = 0;
 
 		//Maximum window dimensions provided by windows
 		uint16_t maxWidth;
 		uint16_t maxHeight;
 
+#ifdef _WIN32
 		//PROCESS SPECIFIC
 		//Pipes to send data to the window process
 		std::string outPipeName;
@@ -132,5 +414,26 @@ namespace cvid
 		SMALL_RECT originalSize;
 		COORD originalSbSize;
 		char originalTitle[128];
+		//Every part of a frame joined for a single write, only grows
+		std::vector<char> outputBuffer;
+#else
+		//PROCESS SPECIFIC
+		//Connected Unix socket to the window process, every message to it starts with its size as a uint32_t
+		int processSocket = -1;
+		//The terminal emulator running the window process, or -1 if it was started by hand
+		pid_t processId = -1;
+		ExitCode processExitCode = 0;
+		//Largest frame in console pixels sent through shared memory, the size of the window process' terminal is not known here
+		static constexpr uint16_t maxSharedFrameWidth = 512;
+		static constexpr uint16_t maxSharedFrameHeight = 512;
+
+		//MAIN SPECIFIC
+		//Terminal settings to restore on close
+		termios originalTermios;
+		bool termiosChanged = false;
+		struct sigaction originalResizeAction;
+		//Input read while waiting for replies from the terminal, returned by the next GetInput
+		std::string pendingInput;
+#endif
 	};
 }
\ No newline at end of file
@@ -0,0 +1,345 @@
+#include <cvid/FrameBroadcaster.h>
+#include <cvid/Helpers.h>
+#include <cstring>
+#include <stdexcept>
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#include <afunix.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+
+namespace cvid
+{
+#ifdef _WIN32
+	constexpr SOCKET invalidSocket = INVALID_SOCKET;
+	constexpr int sendFlags = 0;
+
+	static inline int SocketError()
+	{
+		return WSAGetLastError();
+	}
+
+	static inline bool WouldBlock(int error)
+	{
+		return error == WSAEWOULDBLOCK;
+	}
+
+	static inline bool SetNonBlocking(SOCKET socket)
+	{
+		u_long nonBlocking = 1;
+		return ioctlsocket(socket, FIONBIO, &nonBlocking) == 0;
+	}
+#else
+	constexpr int invalidSocket = -1;
+	//Writing to a viewer which has left must not kill the process with SIGPIPE
+#ifdef MSG_NOSIGNAL
+	constexpr int sendFlags = MSG_NOSIGNAL;
+#else
+	constexpr int sendFlags = 0;
+#endif
+
+	static inline int SocketError()
+	{
+		return errno;
+	}
+
+	static inline bool WouldBlock(int error)
+	{
+		return error == EAGAIN || error == EWOULDBLOCK || error == EINTR;
+	}
+
+	static inline bool SetNonBlocking(int socket)
+	{
+		return fcntl(socket, F_SETFL, fcntl(socket, F_GETFL) | O_NONBLOCK) == 0;
+	}
+#endif
+
+	//Sent ahead of every keyframe, hides the cursor and clears whatever the terminal showed before
+	constexpr std::string_view keyframeStart = "\x1b[?25l\x1b[0m\x1b[2J";
+
+	//Listen for viewers on a Unix domain socket, anything already at the path is replaced
+	FrameBroadcaster::FrameBroadcaster(const std::string& socketPath)
+	{
+#ifdef _WIN32
+		WSADATA wsaData;
+		WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+		sockaddr_un address{};
+		if (socketPath.size() >= sizeof(address.sun_path))
+		{
+			LogError("CVid error in FrameBroadcaster: Socket path " + socketPath + " is too long");
+			throw std::runtime_error("Socket path too long");
+		}
+		address.sun_family = AF_UNIX;
+		memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+
+		//A socket left behind by an earlier run would make bind fail
+#ifdef _WIN32
+		DeleteFileA(socketPath.c_str());
+#else
+		unlink(socketPath.c_str());
+#endif
+		listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listenSocket == invalidSocket || bind(listenSocket, (sockaddr*)&address, sizeof(address)) != 0)
+		{
+			LogError("CVid error in FrameBroadcaster: Failed to bind " + socketPath + ", code " + std::to_string(SocketError()));
+			if (listenSocket != invalidSocket)
+				CloseSocket(listenSocket);
+			throw std::runtime_error("Failed to bind socket");
+		}
+		this->socketPath = socketPath;
+
+		Listen();
+	}
+
+	//Listen for viewers on a TCP port of localhost
+	FrameBroadcaster::FrameBroadcaster(uint16_t port)
+	{
+#ifdef _WIN32
+		WSADATA wsaData;
+		WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+		//Only this machine can connect, the stream is not meant for the network
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+		int reuse = 1;
+		if (listenSocket != invalidSocket)
+			setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+		if (listenSocket == invalidSocket || bind(listenSocket, (sockaddr*)&address, sizeof(address)) != 0)
+		{
+			LogError("CVid error in FrameBroadcaster: Failed to bind port " + std::to_string(port) + ", code " + std::to_string(SocketError()));
+			if (listenSocket != invalidSocket)
+				CloseSocket(listenSocket);
+			throw std::runtime_error("Failed to bind socket");
+		}
+
+		Listen();
+	}
+
+	FrameBroadcaster::~FrameBroadcaster()
+	{
+		for (Viewer& viewer : viewers)
+			CloseSocket(viewer.socket);
+		CloseSocket(listenSocket);
+
+		if (!socketPath.empty())
+		{
+#ifdef _WIN32
+			DeleteFileA(socketPath.c_str());
+#else
+			unlink(socketPath.c_str());
+#endif
+		}
+#ifdef _WIN32
+		WSACleanup();
+#endif
+	}
+
+	//Make the listening socket non blocking and start listening, closes it on failure
+	void FrameBroadcaster::Listen()
+	{
+		if (!SetNonBlocking(listenSocket) || listen(listenSocket, 16) != 0)
+		{
+			LogError("CVid error in FrameBroadcaster: Failed to listen, code " + std::to_string(SocketError()));
+			CloseSocket(listenSocket);
+			throw std::runtime_error("Failed to listen on socket");
+		}
+	}
+
+	//Take every viewer waiting to connect
+	void FrameBroadcaster::Accept()
+	{
+		while (true)
+		{
+			Socket socket = accept(listenSocket, nullptr, nullptr);
+			if (socket == invalidSocket)
+				return;
+
+			if (!SetNonBlocking(socket))
+			{
+				CloseSocket(socket);
+				continue;
+			}
+#if !defined(_WIN32) && !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+			int noSigPipe = 1;
+			setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+			//Frames are written whole, so there is no point in waiting to fill packets
+			int noDelay = 1;
+			setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+
+			Viewer viewer;
+			viewer.socket = socket;
+			viewers.push_back(std::move(viewer));
+		}
+	}
+
+	//Take new viewers and send a frame to everyone, height is in characters
+	void FrameBroadcaster::Broadcast(const CharPixel* frame, uint16_t width, uint16_t height)
+	{
+		Accept();
+
+		//Send what is left of earlier frames, and drop viewers which have left
+		for (size_t i = 0; i < viewers.size();)
+		{
+			if (Flush(viewers[i]))
+			{
+				i++;
+				continue;
+			}
+			CloseSocket(viewers[i].socket);
+			viewers.erase(viewers.begin() + i);
+		}
+
+		if (viewers.empty())
+		{
+			hadViewers = false;
+			return;
+		}
+
+		//Skipped frames are not in the delta encoder's last frame, so it starts over
+		if (!hadViewers)
+			deltaEncoder.Invalidate();
+		hadViewers = true;
+
+		//Encode each kind of frame once, a keyframe only if someone needs it
+		bool anyNeedKeyframe = false;
+		bool anyNeedDelta = false;
+		for (Viewer& viewer : viewers)
+		{
+			//A viewer which is too far behind skips frames until it has caught up, then takes a keyframe
+			if (viewer.backlog > maxBacklog)
+			{
+				viewer.needsKeyframe = true;
+				skippedFrames++;
+				continue;
+			}
+			(viewer.needsKeyframe ? anyNeedKeyframe : anyNeedDelta) = true;
+		}
+
+		//The delta encoder follows every frame so its deltas stay valid for viewers which took a keyframe of the last one
+		std::string_view delta = deltaEncoder.Encode(frame, width, height);
+		std::shared_ptr<const std::string> deltaFrame;
+		if (anyNeedDelta)
+			deltaFrame = std::make_shared<const std::string>(delta);
+
+		std::shared_ptr<const std::string> keyframe;
+		if (anyNeedKeyframe)
+		{
+			keyframeEncoder.Invalidate();
+			std::string_view encoded = keyframeEncoder.Encode(frame, width, height);
+			std::string keyframeString;
+			keyframeString.reserve(keyframeStart.size() + encoded.size());
+			keyframeString.append(keyframeStart);
+			keyframeString.append(encoded);
+			keyframe = std::make_shared<const std::string>(std::move(keyframeString));
+		}
+
+		for (size_t i = 0; i < viewers.size();)
+		{
+			Viewer& viewer = viewers[i];
+			if (viewer.backlog <= maxBacklog)
+			{
+				const std::shared_ptr<const std::string>& queued = viewer.needsKeyframe ? keyframe : deltaFrame;
+				viewer.queue.push_back(queued);
+				viewer.backlog += queued->size();
+				viewer.needsKeyframe = false;
+			}
+
+			if (Flush(viewer))
+			{
+				i++;
+				continue;
+			}
+			CloseSocket(viewer.socket);
+			viewers.erase(viewers.begin() + i);
+		}
+	}
+
+	//Send as much of a viewer's queue as the socket takes, returns false if the viewer is gone
+	bool FrameBroadcaster::Flush(Viewer& viewer)
+	{
+		//Anything the viewer types is thrown away, reading it shows if the viewer has left
+		char discard[256];
+		while (true)
+		{
+			int received = recv(viewer.socket, discard, sizeof(discard), 0);
+			if (received == 0)
+				return false;
+			if (received < 0)
+			{
+				if (!WouldBlock(SocketError()))
+					return false;
+				break;
+			}
+		}
+
+		while (!viewer.queue.empty())
+		{
+			const std::string& front = *viewer.queue.front();
+			int sent = send(viewer.socket, front.data() + viewer.sent, (int)(front.size() - viewer.sent), sendFlags);
+			if (sent < 0)
+				return WouldBlock(SocketError());
+
+			viewer.sent += sent;
+			viewer.backlog -= sent;
+			if (viewer.sent == front.size())
+			{
+				viewer.queue.pop_front();
+				viewer.sent = 0;
+			}
+		}
+		return true;
+	}
+
+	//Set how frames are encoded, every viewer gets a keyframe next
+	void FrameBroadcaster::SetEncoderSettings(EncoderSettings settings)
+	{
+		deltaEncoder.settings = settings;
+		keyframeEncoder.settings = settings;
+		keyframeEncoder.settings.deltaFrames = false;
+		deltaEncoder.Invalidate();
+		for (Viewer& viewer : viewers)
+			viewer.needsKeyframe = true;
+	}
+
+	//Get how frames are encoded
+	EncoderSettings FrameBroadcaster::GetEncoderSettings()
+	{
+		return deltaEncoder.settings;
+	}
+
+	//Get how many viewers are connected
+	size_t FrameBroadcaster::GetViewerCount()
+	{
+		return viewers.size();
+	}
+
+	//Get how many frames have been skipped for viewers which fell behind, counted once per viewer
+	uint64_t FrameBroadcaster::GetSkippedFrames()
+	{
+		return skippedFrames;
+	}
+
+	//Close a socket
+	void FrameBroadcaster::CloseSocket(Socket socket)
+	{
+#ifdef _WIN32
+		closesocket(socket);
+#else
+		close(socket);
+#endif
+	}
+}
\ No newline at end of file
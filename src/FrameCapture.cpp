@@ -0,0 +1,283 @@
+#include <cvid/FrameCapture.h>
+#include <cvid/Helpers.h>
+#include <cstring>
+#include <stdexcept>
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace cvid
+{
+	//Start a new capture file, throws if it cannot be created
+	FrameRecorder::FrameRecorder(const std::string& path)
+	{
+		file.open(path, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			LogError("CVid error in FrameRecorder: Failed to create " + path);
+			throw std::runtime_error("Failed to create capture file");
+		}
+
+		capture::FileHeader header{};
+		memcpy(header.magic, capture::magic, sizeof(header.magic));
+		header.version = 1;
+		file.write((const char*)&header, sizeof(header));
+		offset = sizeof(header);
+
+		start = std::chrono::steady_clock::now();
+	}
+
+	//Finishes the capture file if it was not already
+	FrameRecorder::~FrameRecorder()
+	{
+		Finish();
+	}
+
+	//Add a frame, height is in characters. Returns false if writing failed
+	bool FrameRecorder::Record(const CharPixel* frame, uint16_t width, uint16_t height)
+	{
+		if (finished)
+			return false;
+
+		//Keyframes let a replay start part way through, with an interval of 0 only the first frame is one
+		if (index.empty() || (keyframeInterval != 0 && index.size() % keyframeInterval == 0))
+			codec.Reset();
+
+		bool delta;
+		const std::vector<uint8_t>& compressed = codec.Compress(frame, width, height, delta);
+
+		capture::RecordHeader record{};
+		record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		record.size = (uint32_t)compressed.size();
+		record.keyframe = !delta;
+
+		file.write((const char*)&record, sizeof(record));
+		file.write((const char*)compressed.data(), compressed.size());
+		if (!file)
+		{
+			LogWarning("CVid warning in FrameRecorder: Failed to write frame");
+			return false;
+		}
+
+		index.push_back({ offset, record.timestamp });
+		offset += sizeof(record) + compressed.size();
+		return true;
+	}
+
+	//Write the index and close the file, nothing can be recorded after
+	void FrameRecorder::Finish()
+	{
+		if (finished)
+			return;
+		finished = true;
+
+		capture::Footer footer{};
+		footer.indexOffset = offset;
+		footer.frameCount = index.size();
+		memcpy(footer.magic, capture::magic, sizeof(footer.magic));
+
+		file.write((const char*)index.data(), index.size() * sizeof(capture::IndexEntry));
+		file.write((const char*)&footer, sizeof(footer));
+		file.close();
+	}
+
+	//Get how many frames have been recorded
+	uint64_t FrameRecorder::GetFrameCount()
+	{
+		return index.size();
+	}
+
+	//Open a capture file, throws if it cannot be opened or is not a capture
+	FrameCapture::FrameCapture(const std::string& path)
+	{
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		LARGE_INTEGER fileSize{};
+		if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize))
+		{
+			LogError("CVid error in FrameCapture: Failed to open " + path + ", code " + std::to_string(GetLastError()));
+			if (file != INVALID_HANDLE_VALUE)
+				CloseHandle(file);
+			throw std::runtime_error("Failed to open capture file");
+		}
+		size = (size_t)fileSize.QuadPart;
+
+		if (size >= sizeof(capture::FileHeader))
+		{
+			mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping != NULL)
+				data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		}
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		struct stat info;
+		if (fd < 0 || fstat(fd, &info) != 0)
+		{
+			LogError("CVid error in FrameCapture: Failed to open " + path + ", " + strerror(errno));
+			if (fd >= 0)
+				close(fd);
+			throw std::runtime_error("Failed to open capture file");
+		}
+		size = info.st_size;
+
+		if (size >= sizeof(capture::FileHeader))
+		{
+			void* memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (memory != MAP_FAILED)
+			{
+				data = (const uint8_t*)memory;
+				//Frames are mostly read front to back
+				madvise(memory, size, MADV_SEQUENTIAL);
+			}
+		}
+		//The mapping stays after closing
+		close(fd);
+#endif
+
+		if (!data || memcmp(data, capture::magic, sizeof(capture::magic)) != 0)
+		{
+			LogError("CVid error in FrameCapture: " + path + " is not a capture file");
+			Unmap();
+			throw std::runtime_error("Not a capture file");
+		}
+
+		//Use the index if the file was finished, otherwise find the frames one by one
+		capture::Footer footer;
+		if (size >= sizeof(capture::FileHeader) + sizeof(footer))
+			memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+		if (size >= sizeof(capture::FileHeader) + sizeof(footer) && memcmp(footer.magic, capture::magic, sizeof(footer.magic)) == 0
+			&& footer.frameCount <= size / sizeof(capture::IndexEntry) && footer.indexOffset + footer.frameCount * sizeof(capture::IndexEntry) + sizeof(footer) == size)
+		{
+			index.resize(footer.frameCount);
+			memcpy(index.data(), data + footer.indexOffset, footer.frameCount * sizeof(capture::IndexEntry));
+		}
+		else
+		{
+			LogWarning("CVid warning in FrameCapture: " + path + " was not finished, reading the frames it has");
+			ScanRecords();
+		}
+	}
+
+	FrameCapture::~FrameCapture()
+	{
+		Unmap();
+	}
+
+	//Unmap and close the file
+	void FrameCapture::Unmap()
+	{
+#ifdef _WIN32
+		if (data)
+			UnmapViewOfFile(data);
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (data)
+			munmap((void*)data, size);
+#endif
+		data = nullptr;
+	}
+
+	//Build the index by walking the records of a file which was never finished
+	void FrameCapture::ScanRecords()
+	{
+		size_t position = sizeof(capture::FileHeader);
+		while (size - position >= sizeof(capture::RecordHeader))
+		{
+			capture::RecordHeader record;
+			memcpy(&record, data + position, sizeof(record));
+			//The last frame may have been cut off part way
+			if (record.size > size - position - sizeof(record))
+				break;
+
+			index.push_back({ position, record.timestamp });
+			position += sizeof(record) + record.size;
+		}
+	}
+
+	//Get how many frames there are
+	size_t FrameCapture::GetFrameCount()
+	{
+		return index.size();
+	}
+
+	//Get when a frame was recorded in seconds since the start
+	double FrameCapture::GetTimestamp(size_t frame)
+	{
+		if (frame >= index.size())
+			return 0;
+		return index[frame].timestamp / 1e9;
+	}
+
+	//Get the size of the file in bytes
+	size_t FrameCapture::GetFileSize()
+	{
+		return size;
+	}
+
+	//Get the header of a frame's record and where its data is, returns false if it is outside the file
+	bool FrameCapture::GetRecord(size_t frame, capture::RecordHeader& record, const uint8_t*& recordData)
+	{
+		//Records are packed one after another, so they are copied out instead of read in place
+		uint64_t offset = index[frame].offset;
+		if (offset > size || size - offset < sizeof(record))
+			return false;
+		memcpy(&record, data + offset, sizeof(record));
+
+		if (record.size > size - offset - sizeof(record))
+			return false;
+		recordData = data + offset + sizeof(record);
+		return true;
+	}
+
+	//Decode a frame, width and height are set in characters. Returns nullptr if the frame is broken
+	const CharPixel* FrameCapture::GetFrame(size_t frame, uint16_t& width, uint16_t& height)
+	{
+		if (frame >= index.size())
+			return nullptr;
+
+		//Anything other than the next frame starts from the keyframe before it
+		if (lastDecoded == SIZE_MAX || frame != lastDecoded + 1)
+		{
+			size_t keyframe = frame;
+			while (true)
+			{
+				capture::RecordHeader record;
+				const uint8_t* recordData;
+				if (!GetRecord(keyframe, record, recordData))
+					return nullptr;
+				if (record.keyframe || keyframe == 0)
+					break;
+				keyframe--;
+			}
+
+			lastDecoded = SIZE_MAX;
+			for (size_t i = keyframe; i < frame; i++)
+				if (!DecodeRecord(i, width, height))
+					return nullptr;
+		}
+
+		return DecodeRecord(frame, width, height);
+	}
+
+	//Decode one frame on top of the last decoded one
+	const CharPixel* FrameCapture::DecodeRecord(size_t frame, uint16_t& width, uint16_t& height)
+	{
+		capture::RecordHeader record;
+		const uint8_t* recordData;
+		if (!GetRecord(frame, record, recordData))
+			return nullptr;
+
+		const CharPixel* pixels = codec.Decompress(recordData, record.size, !record.keyframe, width, height);
+		lastDecoded = pixels ? frame : SIZE_MAX;
+		return pixels;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,246 @@
+#include <cvid/FrameCodec.h>
+#include <cstring>
+#include <algorithm>
+#include <array>
+
+namespace cvid
+{
+	//Matches shorter than this are written as literals
+	constexpr size_t minMatch = 4;
+	//Furthest back a match can be, offsets are written in 2 bytes
+	constexpr size_t maxOffset = 65535;
+	//Bits of the hash table which finds matches
+	constexpr int hashBits = 12;
+
+	static inline uint32_t Read32(const uint8_t* data)
+	{
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	static inline uint32_t Hash(uint32_t value)
+	{
+		return (value * 2654435761u) >> (32 - hashBits);
+	}
+
+	//Write the rest of a length which did not fit in its 4 bits of the token
+	static inline void WriteLength(std::vector<uint8_t>& output, size_t length)
+	{
+		for (; length >= 255; length -= 255)
+			output.push_back(255);
+		output.push_back((uint8_t)length);
+	}
+
+	//Read the rest of a length which did not fit in its 4 bits of the token, returns false if the input ends
+	static inline bool ReadLength(const uint8_t* input, size_t size, size_t& position, size_t& length)
+	{
+		uint8_t next;
+		do
+		{
+			if (position >= size)
+				return false;
+			next = input[position++];
+			length += next;
+		} while (next == 255);
+		return true;
+	}
+
+	//Write one sequence of literals followed by a match, matchLength 0 means there is no match
+	static void WriteSequence(std::vector<uint8_t>& output, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength)
+	{
+		//Each length has 4 bits in the token, 15 means more follows
+		size_t matchCode = matchLength ? matchLength - minMatch : 0;
+		output.push_back((uint8_t)((std::min(literalLength, (size_t)15) << 4) | std::min(matchCode, (size_t)15)));
+
+		if (literalLength >= 15)
+			WriteLength(output, literalLength - 15);
+		output.insert(output.end(), literals, literals + literalLength);
+
+		if (matchLength == 0)
+			return;
+		output.push_back((uint8_t)offset);
+		output.push_back((uint8_t)(offset >> 8));
+		if (matchCode >= 15)
+			WriteLength(output, matchCode - 15);
+	}
+
+	//Compress bytes with a fast LZ77 codec, runs of repeating bytes or pixels become single matches
+	//The output is appended to, it is a list of sequences of a token, literals, and a match, the last sequence has no match
+	void FrameCodec::CompressLZ(const uint8_t* input, size_t size, std::vector<uint8_t>& output)
+	{
+		//Last position each hash was seen at plus one, 0 is empty
+		std::array<uint32_t, 1 << hashBits> table{};
+
+		size_t position = 0;
+		size_t anchor = 0;
+		while (position + minMatch <= size)
+		{
+			uint32_t value = Read32(input + position);
+			uint32_t& entry = table[Hash(value)];
+			size_t candidate = entry;
+			entry = (uint32_t)position + 1;
+
+			if (candidate == 0 || position + 1 - candidate > maxOffset || Read32(input + candidate - 1) != value)
+			{
+				//Skip ahead faster the longer nothing has matched, so incompressible data does not take long
+				position += 1 + ((position - anchor) >> 6);
+				continue;
+			}
+			candidate--;
+
+			//Matches may overlap the bytes being written, which is what turns runs into one match
+			size_t length = minMatch;
+			while (position + length < size && input[candidate + length] == input[position + length])
+				length++;
+
+			WriteSequence(output, input + anchor, position - anchor, position - candidate, length);
+			position += length;
+			anchor = position;
+		}
+
+		WriteSequence(output, input + anchor, size - anchor, 0, 0);
+	}
+
+	//Decompress bytes made by CompressLZ into exactly outputSize bytes, returns false if the data is broken
+	bool FrameCodec::DecompressLZ(const uint8_t* input, size_t size, uint8_t* output, size_t outputSize)
+	{
+		size_t in = 0;
+		size_t out = 0;
+		while (in < size)
+		{
+			uint8_t token = input[in++];
+
+			size_t literalLength = token >> 4;
+			if (literalLength == 15 && !ReadLength(input, size, in, literalLength))
+				return false;
+			if (literalLength > size - in || literalLength > outputSize - out)
+				return false;
+			memcpy(output + out, input + in, literalLength);
+			in += literalLength;
+			out += literalLength;
+
+			//Only the last sequence ends without a match
+			if (in == size)
+				break;
+
+			if (size - in < 2)
+				return false;
+			size_t offset = input[in] | (input[in + 1] << 8);
+			in += 2;
+			size_t matchLength = token & 15;
+			if (matchLength == 15 && !ReadLength(input, size, in, matchLength))
+				return false;
+			matchLength += minMatch;
+			if (offset == 0 || offset > out || matchLength > outputSize - out)
+				return false;
+
+			const uint8_t* match = output + out - offset;
+			if (offset >= matchLength)
+			{
+				memcpy(output + out, match, matchLength);
+			}
+			else
+			{
+				//Overlapping, each byte may be one just written
+				for (size_t i = 0; i < matchLength; i++)
+					output[out + i] = match[i];
+			}
+			out += matchLength;
+		}
+		return out == outputSize;
+	}
+
+	//Compress a frame, height is in characters. delta is set if it was compressed against the previous frame
+	const std::vector<uint8_t>& FrameCodec::Compress(const CharPixel* frame, uint16_t width, uint16_t height, bool& delta)
+	{
+		const size_t pixels = (size_t)width * height;
+		const size_t bytes = pixels * sizeof(CharPixel);
+
+		FrameHeader header{ width, height };
+		output.resize(sizeof(header));
+		memcpy(output.data(), &header, sizeof(header));
+
+		delta = !previous.empty() && previousWidth == width && previousHeight == height;
+		if (delta)
+		{
+			//Unchanged cells become zeros, which compress to almost nothing
+			difference.resize(bytes);
+			const uint8_t* current = (const uint8_t*)frame;
+			const uint8_t* last = (const uint8_t*)previous.data();
+			for (size_t i = 0; i < bytes; i++)
+				difference[i] = current[i] ^ last[i];
+			CompressLZ(difference.data(), bytes, output);
+		}
+		else
+		{
+			CompressLZ((const uint8_t*)frame, bytes, output);
+		}
+
+		previous.assign(frame, frame + pixels);
+		previousWidth = width;
+		previousHeight = height;
+		return output;
+	}
+
+	//Decompress a frame made by Compress, width and height are set in characters
+	const CharPixel* FrameCodec::Decompress(const uint8_t* data, size_t size, bool delta, uint16_t& width, uint16_t& height)
+	{
+		FrameHeader header;
+		if (size < sizeof(header))
+			return nullptr;
+		memcpy(&header, data, sizeof(header));
+		data += sizeof(header);
+		size -= sizeof(header);
+
+		const size_t pixels = (size_t)header.width * header.height;
+		const size_t bytes = pixels * sizeof(CharPixel);
+
+		if (delta)
+		{
+			//Can only be applied to the frame it was made against
+			if (previous.empty() || previousWidth != header.width || previousHeight != header.height)
+				return nullptr;
+
+			difference.resize(bytes);
+			if (!DecompressLZ(data, size, difference.data(), bytes))
+			{
+				Reset();
+				return nullptr;
+			}
+			uint8_t* last = (uint8_t*)previous.data();
+			for (size_t i = 0; i < bytes; i++)
+				last[i] ^= difference[i];
+		}
+		else
+		{
+			previous.resize(pixels);
+			if (!DecompressLZ(data, size, (uint8_t*)previous.data(), bytes))
+			{
+				Reset();
+				return nullptr;
+			}
+		}
+
+		previousWidth = header.width;
+		previousHeight = header.height;
+		width = header.width;
+		height = header.height;
+		return previous.data();
+	}
+
+	//Forget the previous frame so the next one is compressed on its own
+	void FrameCodec::Reset()
+	{
+		previous.clear();
+		previousWidth = 0;
+		previousHeight = 0;
+	}
+	//Get the most bytes Compress can return for a frame of this many character pixels
+	size_t FrameCodec::MaxCompressedSize(size_t pixels)
+	{
+		//Incompressible data is one long literal with a length byte for every 255 bytes
+		size_t bytes = pixels * sizeof(CharPixel);
+		return sizeof(FrameHeader) + bytes + bytes / 255 + 16;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,432 @@
+#include <cvid/FrameEncoder.h>
+#include <array>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+
+namespace cvid
+{
+	//Decimal representation of a byte
+	struct DecimalByte
+	{
+		char digits[3];
+		uint8_t length;
+	};
+
+	//Decimal representations of 0-255, generated at compile time
+	static constexpr std::array<DecimalByte, 256> decimalBytes = []()
+	{
+		std::array<DecimalByte, 256> table{};
+		for (int i = 0; i < 256; i++)
+		{
+			DecimalByte& d = table[i];
+			if (i >= 100)
+				d = { { char('0' + i / 100), char('0' + i / 10 % 10), char('0' + i % 10) }, 3 };
+			else if (i >= 10)
+				d = { { char('0' + i / 10), char('0' + i % 10), 0 }, 2 };
+			else
+				d = { { char('0' + i), 0, 0 }, 1 };
+		}
+		return table;
+	}();
+
+	//Most bytes a single cell can take: a cursor jump, a combined color change, and the character
+	constexpr size_t maxCellBytes = 64;
+
+	//Compare the rgb of two colors, alpha is not shown in the console
+	static inline bool SameColor(const Color& a, const Color& b)
+	{
+		return a.r == b.r && a.g == b.g && a.b == b.b;
+	}
+	//Compare everything visible about two character pixels
+	static inline bool SamePixel(const CharPixel& a, const CharPixel& b)
+	{
+		return a.character == b.character && SameColor(a.fg, b.fg) && SameColor(a.bg, b.bg);
+	}
+	//Number of decimal digits in a positive number
+	static inline size_t NumDigits(size_t n)
+	{
+		size_t digits = 1;
+		while (n >= 10)
+		{
+			n /= 10;
+			digits++;
+		}
+		return digits;
+	}
+
+	//Write a string literal without its null terminator
+	template<size_t N>
+	static inline char* WriteLiteral(char* out, const char(&literal)[N])
+	{
+		memcpy(out, literal, N - 1);
+		return out + N - 1;
+	}
+	//Write a byte in decimal, always copies 3 bytes so the buffer needs some slack
+	static inline char* WriteByte(char* out, uint8_t n)
+	{
+		const DecimalByte& d = decimalBytes[n];
+		memcpy(out, d.digits, 3);
+		return out + d.length;
+	}
+	//Write a number in decimal
+	static inline char* WriteNumber(char* out, size_t n)
+	{
+		if (n < 256)
+			return WriteByte(out, (uint8_t)n);
+
+		//Write the digits backwards and then move them in place
+		char digits[20];
+		size_t length = 0;
+		while (n > 0)
+		{
+			digits[length++] = char('0' + n % 10);
+			n /= 10;
+		}
+		while (length > 0)
+			*out++ = digits[--length];
+		return out;
+	}
+	//Key meaning the console color is not known and has to be set
+	constexpr uint32_t unknownColor = UINT32_MAX;
+
+	//Code page 437 block characters
+	constexpr char upperHalfBlock = (char)223;
+	constexpr char lowerHalfBlock = (char)220;
+	constexpr char fullBlock = (char)219;
+	constexpr char emptyBlock = ' ';
+
+	//UTF-8 encoding of a code page 437 character
+	struct Utf8Glyph
+	{
+		char bytes[3];
+		uint8_t length;
+	};
+
+	//UTF-8 of the code page 437 block and shade characters, anything else is written as is
+	static constexpr std::array<Utf8Glyph, 128> utf8Glyphs = []()
+	{
+		std::array<Utf8Glyph, 128> table{};
+		//Code points of U+25xx
+		constexpr std::pair<uint8_t, uint8_t> blocks[] = {
+			{ 176, 0x91 }, { 177, 0x92 }, { 178, 0x93 }, { 219, 0x88 },
+			{ 220, 0x84 }, { 221, 0x8C }, { 222, 0x90 }, { 223, 0x80 }
+		};
+		for (const auto& [character, low] : blocks)
+			table[character - 128] = { { (char)0xE2, (char)0x96, (char)low }, 3 };
+		table[254 - 128] = { { (char)0xE2, (char)0x96, (char)0xA0 }, 3 };
+		return table;
+	}();
+
+	//Pack the rgb of a color into a key, alpha is not shown in the console
+	static inline uint32_t PackColor(const Color& color)
+	{
+		return (uint32_t)color.r | ((uint32_t)color.g << 8) | ((uint32_t)color.b << 16);
+	}
+
+	//Encode a frame, height is in characters. The returned string is valid until the next call
+	std::string_view FrameEncoder::Encode(const CharPixel* frame, uint16_t width, uint16_t height)
+	{
+		const std::vector<std::string_view>& encodedBands = EncodeBands(frame, width, height);
+
+		//Join the bands
+		size_t length = 0;
+		for (const std::string_view& band : encodedBands)
+			length += band.size();
+		if (output.size() < length)
+			output.resize(length);
+
+		char* out = output.data();
+		for (const std::string_view& band : encodedBands)
+		{
+			memcpy(out, band.data(), band.size());
+			out += band.size();
+		}
+
+		return std::string_view(output.data(), length);
+	}
+
+	//Encode a frame into one string per band of rows without joining them
+	const std::vector<std::string_view>& FrameEncoder::EncodeBands(const CharPixel* frame, uint16_t width, uint16_t height)
+	{
+		size_t numBands = (height + bandRows - 1) / bandRows;
+		if (bands.size() < numBands)
+			bands.resize(numBands);
+
+		//Start or resize the thread pool if the settings changed
+		size_t numWorkers = std::max(settings.numThreads, (uint16_t)1) - 1;
+		if (numWorkers == 0)
+			threadPool.reset();
+		else if (!threadPool || threadPool->GetThreadCount() != numWorkers + 1)
+			threadPool = std::make_unique<ThreadPool>(numWorkers);
+
+		//A delta frame is only possible if the console still shows the last frame
+		bool delta = settings.deltaFrames && lastFrameValid && width == lastWidth && height == lastHeight;
+
+		//Every band is independent, so they can be encoded in any order
+		auto encodeBand = [&](size_t i)
+			{
+				EncodeBand(bands[i], frame, width, i * bandRows, std::min<size_t>((i + 1) * bandRows, height), delta);
+			};
+		if (threadPool)
+			threadPool->ParallelFor(numBands, encodeBand);
+		else
+			for (size_t i = 0; i < numBands; i++)
+				encodeBand(i);
+
+		bandOutputs.clear();
+		for (size_t i = 0; i < numBands; i++)
+			bandOutputs.emplace_back(bands[i].output.data(), bands[i].length);
+
+		//Remember this frame for the next delta
+		if (settings.deltaFrames)
+		{
+			lastFrame.assign(frame, frame + (size_t)width * height);
+			lastWidth = width;
+			lastHeight = height;
+			lastFrameValid = true;
+		}
+
+		return bandOutputs;
+	}
+
+	//Forget the last frame so the next one is fully redrawn
+	void FrameEncoder::Invalidate()
+	{
+		lastFrameValid = false;
+	}
+
+	//Encode the rows [firstRow, endRow) into a band
+	void FrameEncoder::EncodeBand(Band& band, const CharPixel* frame, uint16_t width, size_t firstRow, size_t endRow, bool delta) const
+	{
+		//Make sure even the worst case band fits
+		size_t maxBytes = ((size_t)width + 1) * (endRow - firstRow) * maxCellBytes;
+		if (band.output.size() < maxBytes)
+			band.output.resize(maxBytes);
+		if (band.fgKeys.size() < width)
+		{
+			band.fgKeys.resize(width);
+			band.bgKeys.resize(width);
+			band.rowColors.resize(width);
+			band.rowIndices.resize(width);
+		}
+
+		//Colors are unknown at the start of a band, both because anything could have changed them since the last frame
+		//and so bands do not depend on each other
+		band.currentFg = unknownColor;
+		band.currentBg = unknownColor;
+
+		char* out = band.output.data();
+		for (size_t y = firstRow; y < endRow; y++)
+		{
+			if (delta)
+				out = EncodeDeltaRow(band, out, frame + y * width, lastFrame.data() + y * width, width, y);
+			else
+				out = EncodeFullRow(band, out, frame + y * width, width, y);
+		}
+		band.length = out - band.output.data();
+	}
+
+	//Append every cell of a row
+	char* FrameEncoder::EncodeFullRow(Band& band, char* out, const CharPixel* row, uint16_t width, size_t y) const
+	{
+		ConvertRow(band, row, width);
+
+		//Windows 11 broke text wrapping, so do we it here. Also for some reason it starts from 1
+		//Format: \x1b[<row>;0f
+		out = WriteLiteral(out, "\x1b[");
+		out = WriteNumber(out, y + 1);
+		out = WriteLiteral(out, ";0f");
+
+		for (size_t x = 0; x < width; x++)
+			out = AppendCell(band, out, row[x].character, band.fgKeys[x], band.bgKeys[x]);
+		return out;
+	}
+
+	//Append only the cells of a row which differ from the last frame
+	char* FrameEncoder::EncodeDeltaRow(Band& band, char* out, const CharPixel* row, const CharPixel* lastRow, uint16_t width, size_t y) const
+	{
+		//Skip converting rows which did not change at all
+		size_t x = 0;
+		while (x < width && SamePixel(row[x], lastRow[x]))
+			x++;
+		if (x == width)
+			return out;
+		ConvertRow(band, row, width);
+
+		//Column the console cursor is on, unknown at the start of each row
+		size_t cursorX = SIZE_MAX;
+
+		for (; x < width; x++)
+		{
+			//Unchanged cells are skipped
+			if (SamePixel(row[x], lastRow[x]))
+				continue;
+
+			//The cursor needs to be moved here, either by jumping or by redrawing the unchanged cells in between
+			if (cursorX != x)
+			{
+				//Format: \x1b[<row>;<column>H
+				size_t jumpCost = 4 + NumDigits(y + 1) + NumDigits(x + 1);
+
+				//Redrawing is cheaper if the gap is short and needs no color changes, UTF-8 blocks take 3 bytes each
+				size_t glyphCost = settings.utf8Glyphs ? 3 : 1;
+				bool bridge = cursorX < x && (x - cursorX) * glyphCost < jumpCost;
+				for (size_t i = cursorX; bridge && i < x; i++)
+				{
+					uint32_t fgKey = band.fgKeys[i];
+					uint32_t bgKey = band.bgKeys[i];
+					ChooseGlyph(band, row[i].character, fgKey, bgKey);
+					bridge = fgKey == band.currentFg && bgKey == band.currentBg;
+				}
+
+				if (bridge)
+				{
+					for (size_t i = cursorX; i < x; i++)
+						out = AppendCell(band, out, row[i].character, band.fgKeys[i], band.bgKeys[i]);
+				}
+				else
+				{
+					out = WriteLiteral(out, "\x1b[");
+					out = WriteNumber(out, y + 1);
+					*out++ = ';';
+					out = WriteNumber(out, x + 1);
+					*out++ = 'H';
+				}
+			}
+
+			out = AppendCell(band, out, row[x].character, band.fgKeys[x], band.bgKeys[x]);
+			cursorX = x + 1;
+		}
+		return out;
+	}
+
+	//Convert the colors of a row into the band's fgKeys and bgKeys
+	void FrameEncoder::ConvertRow(Band& band, const CharPixel* row, uint16_t width) const
+	{
+		if (settings.colorMode == ColorMode::TrueColor)
+		{
+			for (size_t x = 0; x < width; x++)
+			{
+				band.fgKeys[x] = PackColor(row[x].fg);
+				band.bgKeys[x] = PackColor(row[x].bg);
+			}
+			return;
+		}
+
+		//Gather each color into a contiguous row so it can be quantized in bulk
+		for (size_t x = 0; x < width; x++)
+			band.rowColors[x] = row[x].fg;
+		QuantizeColors(band.rowColors.data(), width, settings.colorMode, band.rowIndices.data());
+		for (size_t x = 0; x < width; x++)
+			band.fgKeys[x] = band.rowIndices[x];
+
+		for (size_t x = 0; x < width; x++)
+			band.rowColors[x] = row[x].bg;
+		QuantizeColors(band.rowColors.data(), width, settings.colorMode, band.rowIndices.data());
+		for (size_t x = 0; x < width; x++)
+			band.bgKeys[x] = band.rowIndices[x];
+	}
+
+	//Pick the glyph needing the fewest color changes for a cell, the keys are changed to the colors it needs
+	char FrameEncoder::ChooseGlyph(const Band& band, char character, uint32_t& fgKey, uint32_t& bgKey) const
+	{
+		//Only half block pixels can be swapped around, text is left alone
+		if (!settings.optimizeGlyphs || character != upperHalfBlock)
+			return character;
+
+		//Both pixels are the same, so only one of the colors matters
+		if (fgKey == bgKey)
+		{
+			//Whichever color is already set is used, otherwise change the foreground
+			if (fgKey == band.currentFg || fgKey != band.currentBg)
+			{
+				bgKey = band.currentBg;
+				return fullBlock;
+			}
+			fgKey = band.currentFg;
+			return emptyBlock;
+		}
+
+		//Top pixel is the foreground in upper half, and the background in lower half
+		int upperChanges = (fgKey != band.currentFg) + (bgKey != band.currentBg);
+		int lowerChanges = (bgKey != band.currentFg) + (fgKey != band.currentBg);
+		if (lowerChanges < upperChanges)
+		{
+			std::swap(fgKey, bgKey);
+			return lowerHalfBlock;
+		}
+		return upperHalfBlock;
+	}
+
+	//Append one cell, changing colors if needed
+	char* FrameEncoder::AppendCell(Band& band, char* out, char character, uint32_t fgKey, uint32_t bgKey) const
+	{
+		character = ChooseGlyph(band, character, fgKey, bgKey);
+
+		bool fgChanged = fgKey != band.currentFg;
+		bool bgChanged = bgKey != band.currentBg;
+
+		//Change both colors in one sequence if needed
+		//Format: \x1b[<fg>;<bg>m
+		if (fgChanged || bgChanged)
+		{
+			out = WriteLiteral(out, "\x1b[");
+			if (fgChanged)
+				out = AppendColor(out, fgKey, false);
+			if (fgChanged && bgChanged)
+				*out++ = ';';
+			if (bgChanged)
+				out = AppendColor(out, bgKey, true);
+			*out++ = 'm';
+
+			band.currentFg = fgKey;
+			band.currentBg = bgKey;
+		}
+
+		return AppendCharacter(out, character);
+	}
+
+	//Append a character, converting it to UTF-8 if needed
+	char* FrameEncoder::AppendCharacter(char* out, char character) const
+	{
+		if (settings.utf8Glyphs && (uint8_t)character >= 128)
+		{
+			const Utf8Glyph& glyph = utf8Glyphs[(uint8_t)character - 128];
+			if (glyph.length > 0)
+			{
+				memcpy(out, glyph.bytes, 3);
+				return out + glyph.length;
+			}
+		}
+
+		*out++ = character;
+		return out;
+	}
+
+	//Append the SGR parameters to set a color
+	char* FrameEncoder::AppendColor(char* out, uint32_t key, bool background) const
+	{
+		switch (settings.colorMode)
+		{
+		case ColorMode::TrueColor:
+			//Format: 38;2;<r>;<g>;<b> or 48;2;<r>;<g>;<b>
+			out = background ? WriteLiteral(out, "48;2;") : WriteLiteral(out, "38;2;");
+			out = WriteByte(out, key & 0xff);
+			*out++ = ';';
+			out = WriteByte(out, (key >> 8) & 0xff);
+			*out++ = ';';
+			return WriteByte(out, (key >> 16) & 0xff);
+
+		case ColorMode::Palette256:
+			//Format: 38;5;<index> or 48;5;<index>
+			out = background ? WriteLiteral(out, "48;5;") : WriteLiteral(out, "38;5;");
+			return WriteByte(out, (uint8_t)key);
+
+		case ColorMode::Palette16:
+			//Format: 30-37 and 90-97 for foreground, 40-47 and 100-107 for background
+			return WriteByte(out, (uint8_t)((key < 8 ? 30 + key : 82 + key) + (background ? 10 : 0)));
+		}
+		return out;
+	}
+}
\ No newline at end of file
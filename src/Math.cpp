@@ -1,14 +1,29 @@
 #include <cvid/Math.h>
-#include <cvid/Math.h>
 
 namespace cvid
 {
 	//Linearly interpolate values for each point between start and end (both inclusive)
 	std::vector<double> LerpRange(int start, int end, double a, double b)
 	{
-		int range = abs(start - end);
 		std::vector<double> values;
-		values.reserve(range);
+		LerpRange(start, end, a, b, values);
+		return values;
+	}
+
+	//Linearly interpolate Vector2 values for each point between start and end (both inclusive)
+	std::vector<Vector2> LerpRange2D(int start, int end, Vector2 a, Vector2 b)
+	{
+		std::vector<Vector2> values;
+		LerpRange2D(start, end, a, b, values);
+		return values;
+	}
+
+	//Linearly interpolate values for each point between start and end (both inclusive) into values, replacing what it had
+	//Does not allocate once values is big enough, so the same vector can be reused every scanline
+	void LerpRange(int start, int end, double a, double b, std::vector<double>& values)
+	{
+		int range = abs(start - end);
+		values.resize(range + 1);
 
 		//Slope
 		double m = (b - a) / (range);
@@ -18,19 +33,17 @@ namespace cvid
 		for (int i = 0; i <= range; i++)
 		{
 			//Interpolate d
-			values.push_back(d);
+			values[i] = d;
 			d += m;
 		}
-
-		return values;
 	}
 
-	//Linearly interpolate Vector2 values for each point between start and end (both inclusive)
-	std::vector<Vector2> LerpRange2D(int start, int end, Vector2 a, Vector2 b)
+	//Linearly interpolate Vector2 values for each point between start and end (both inclusive) into values, replacing what it had
+	//Does not allocate once values is big enough, so the same vector can be reused every scanline
+	void LerpRange2D(int start, int end, Vector2 a, Vector2 b, std::vector<Vector2>& values)
 	{
 		int range = abs(start - end);
-		std::vector<Vector2> values;
-		values.reserve(range);
+		values.resize(range + 1);
 
 		//Slope
 		Vector2 m = (b - a) / (range);
@@ -40,10 +53,8 @@ namespace cvid
 		for (int i = 0; i <= range; i++)
 		{
 			//Interpolate both d.x and d.y
-			values.push_back(d);
+			values[i] = d;
 			d += m;
 		}
-
-		return values;
 	}
 }
\ No newline at end of file
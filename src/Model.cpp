@@ -217,32 +217,31 @@ namespace cvid
 	}
 
 	//Recalculate the bounding sphere, this should be called after scale has been changed
+	//The vertices are transformed again for the radius instead of being kept, so this does not allocate
 	void ModelInstance::RecalculateBounds()
 	{
 		//Calculate the center point of the vertices after applying transform
-		std::vector<Vector3> transformedVerts;
-		transformedVerts.reserve(model->vertices.size());
 		boundingSphere.center = Vector3();
 		for (const Vertex& vert : model->vertices)
 		{
 			//Apply transform to each vertice
-			transformedVerts.push_back(Vector3(GetTransform() * Vector4(vert.position, 1)));
-			boundingSphere.center += transformedVerts.back();
+			boundingSphere.center += Vector3(GetTransform() * Vector4(vert.position, 1));
 		}
-		boundingSphere.center /= transformedVerts.size();
+		boundingSphere.center /= model->vertices.size();
 
 		//Recalculate the radius if scale has been changed
 		if (staleBounds >= 2)
 		{
 			//The radius of the sphere is defined as the distance from the center to the furthest vertex
 			boundingSphere.radius = 0;
-			for (const Vector3& vert : transformedVerts)
+			for (const Vertex& vert : model->vertices)
 			{
-				double dist = vert.Distance(boundingSphere.center);
+				Vector3 transformed = Vector3(GetTransform() * Vector4(vert.position, 1));
+				double dist = transformed.Distance(boundingSphere.center);
 				if (dist > boundingSphere.radius)
 				{
 					boundingSphere.radius = dist;
-					boundingSphere.farthestPoint = vert;
+					boundingSphere.farthestPoint = transformed;
 				}
 			}
 		}
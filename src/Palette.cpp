@@ -0,0 +1,150 @@
+#include <cvid/Palette.h>
+#include <array>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define CVID_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace cvid
+{
+	//Bits per channel kept in the lookup tables, 5 bits is at most 4 off per channel
+	constexpr int lutBits = 5;
+	constexpr int lutSize = 1 << (lutBits * 3);
+
+	//The default Windows console colors in ANSI order
+	static constexpr std::array<Color, 16> palette16 = { {
+		{ 12, 12, 12 }, { 197, 15, 31 }, { 19, 161, 14 }, { 193, 156, 0 },
+		{ 0, 55, 218 }, { 136, 23, 152 }, { 58, 150, 221 }, { 204, 204, 204 },
+		{ 118, 118, 118 }, { 231, 72, 86 }, { 22, 198, 12 }, { 249, 241, 165 },
+		{ 59, 120, 255 }, { 180, 0, 158 }, { 97, 214, 214 }, { 242, 242, 242 }
+	} };
+	//Channel levels of the xterm 6x6x6 color cube
+	static constexpr std::array<uint8_t, 6> cubeLevels = { 0, 95, 135, 175, 215, 255 };
+
+	//Get the rgb value of a palette index
+	Color PaletteColor(uint8_t index, ColorMode mode)
+	{
+		//The first 16 entries of the 256 palette are the same as the 16 palette
+		if (mode == ColorMode::Palette16 || index < 16)
+			return palette16[index % 16];
+
+		//6x6x6 color cube
+		if (index < 232)
+		{
+			index -= 16;
+			return Color{ cubeLevels[index / 36], cubeLevels[index / 6 % 6], cubeLevels[index % 6] };
+		}
+
+		//24 step grayscale ramp
+		uint8_t gray = 8 + (index - 232) * 10;
+		return Color{ gray, gray, gray };
+	}
+
+	//Perceptually weighted squared distance between two colors
+	static inline int ColorDistance(Color a, Color b)
+	{
+		int dr = a.r - b.r;
+		int dg = a.g - b.g;
+		int db = a.b - b.b;
+		return 2 * dr * dr + 4 * dg * dg + 3 * db * db;
+	}
+
+	//Find the closest palette index by checking every entry
+	static uint8_t NearestPaletteIndex(Color color, ColorMode mode)
+	{
+		//The first 16 entries of the 256 palette are user themeable, so avoid them
+		int first = mode == ColorMode::Palette256 ? 16 : 0;
+		int last = mode == ColorMode::Palette256 ? 255 : 15;
+
+		int bestIndex = first;
+		int bestDistance = INT32_MAX;
+		for (int i = first; i <= last; i++)
+		{
+			int distance = ColorDistance(color, PaletteColor(i, mode));
+			if (distance < bestDistance)
+			{
+				bestDistance = distance;
+				bestIndex = i;
+			}
+		}
+		return bestIndex;
+	}
+
+	//Build the lookup table of closest palette indices for every color at lutBits precision
+	static std::array<uint8_t, lutSize> BuildLut(ColorMode mode)
+	{
+		std::array<uint8_t, lutSize> lut;
+		constexpr int shift = 8 - lutBits;
+		constexpr int channelMask = (1 << lutBits) - 1;
+		constexpr int binCenter = 1 << (shift - 1);
+		for (int i = 0; i < lutSize; i++)
+		{
+			//Use the center of each bin
+			Color color{
+				(uint8_t)((((i >> (lutBits * 2)) & channelMask) << shift) + binCenter),
+				(uint8_t)((((i >> lutBits) & channelMask) << shift) + binCenter),
+				(uint8_t)(((i & channelMask) << shift) + binCenter)
+			};
+			lut[i] = NearestPaletteIndex(color, mode);
+		}
+		return lut;
+	}
+
+	//Get the lookup table of a palette, built on first use
+	static const uint8_t* GetLut(ColorMode mode)
+	{
+		static const std::array<uint8_t, lutSize> lut256 = BuildLut(ColorMode::Palette256);
+		static const std::array<uint8_t, lutSize> lut16 = BuildLut(ColorMode::Palette16);
+		return mode == ColorMode::Palette256 ? lut256.data() : lut16.data();
+	}
+
+	//Index into the lookup table of a color
+	static inline uint32_t LutIndex(Color color)
+	{
+		constexpr int shift = 8 - lutBits;
+		return ((uint32_t)(color.r >> shift) << (lutBits * 2)) | ((uint32_t)(color.g >> shift) << lutBits) | (uint32_t)(color.b >> shift);
+	}
+
+	//Find the closest palette index of a color in O(1) using a lookup table
+	uint8_t QuantizeColor(Color color, ColorMode mode)
+	{
+		return GetLut(mode)[LutIndex(color)];
+	}
+
+	//Find the closest palette index for each color in an array, vectorized where available
+	void QuantizeColors(const Color* colors, size_t count, ColorMode mode, uint8_t* indices)
+	{
+		const uint8_t* lut = GetLut(mode);
+		size_t i = 0;
+
+#ifdef CVID_SSE2
+		//Colors are 4 bytes of rgba, so 4 of them fit in a register
+		static_assert(sizeof(Color) == 4);
+		constexpr int shift = 8 - lutBits;
+		const __m128i channelMask = _mm_set1_epi32((1 << lutBits) - 1);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i rgba = _mm_loadu_si128((const __m128i*)(colors + i));
+
+			//Pull the top bits of each channel into place
+			__m128i r = _mm_and_si128(_mm_srli_epi32(rgba, shift), channelMask);
+			__m128i g = _mm_and_si128(_mm_srli_epi32(rgba, 8 + shift), channelMask);
+			__m128i b = _mm_and_si128(_mm_srli_epi32(rgba, 16 + shift), channelMask);
+			__m128i lutIndex = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, lutBits * 2), _mm_slli_epi32(g, lutBits)), b);
+
+			//SSE2 has no gather so the table lookups stay scalar
+			alignas(16) uint32_t lutIndices[4];
+			_mm_store_si128((__m128i*)lutIndices, lutIndex);
+			indices[i] = lut[lutIndices[0]];
+			indices[i + 1] = lut[lutIndices[1]];
+			indices[i + 2] = lut[lutIndices[2]];
+			indices[i + 3] = lut[lutIndices[3]];
+		}
+#endif
+
+		//Scalar path for the rest
+		for (; i < count; i++)
+			indices[i] = lut[LutIndex(colors[i])];
+	}
+}
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include <cvid/QualityController.h>
+#include <cvid/Rasterizer.h>
+#include <algorithm>
+
+namespace cvid
+{
+	//Shortest wait before raising the quality after a change, and the longest it can back off to
+	constexpr double minRaiseDelay = 1;
+	constexpr double maxRaiseDelay = 16;
+
+	QualityController::QualityController(Window* window, double targetFps)
+	{
+		this->window = window;
+		this->targetFps = targetFps;
+		raiseDelay = minRaiseDelay;
+
+		frameStart = Clock::now();
+		presentStart = frameStart;
+		periodStart = frameStart;
+	}
+
+	//Call before drawing anything for a frame
+	void QualityController::BeginFrame()
+	{
+		frameStart = Clock::now();
+		presentStart = frameStart;
+	}
+
+	//Call right before DrawFrame
+	void QualityController::BeginPresent()
+	{
+		presentStart = Clock::now();
+	}
+
+	//Call after DrawFrame, changes the quality if the frame rate has been off for long enough
+	void QualityController::EndFrame()
+	{
+		Clock::time_point now = Clock::now();
+		totalFrameTime += std::chrono::duration<double>(now - frameStart).count();
+		totalRenderTime += std::chrono::duration<double>(presentStart - frameStart).count();
+		//The window measures this itself since the present thread may be the one doing it
+		totalPresentTime += window->GetPresentTime();
+		periodFrames++;
+
+		double periodTime = std::chrono::duration<double>(now - periodStart).count();
+		if (periodTime < measurePeriod)
+			return;
+
+		double frameTime = totalFrameTime / periodFrames;
+		renderTime = totalRenderTime / periodFrames;
+		presentTime = totalPresentTime / periodFrames;
+		totalFrameTime = 0;
+		totalRenderTime = 0;
+		totalPresentTime = 0;
+		periodFrames = 0;
+		periodStart = now;
+		timeSinceChange += periodTime;
+
+		if (!enabled)
+			return;
+
+		//A present thread can fall behind while the frame loop keeps up, so whichever is slower sets the frame rate
+		double budget = 1 / targetFps;
+		double cost = std::max(frameTime, presentTime);
+
+		if (cost > budget)
+		{
+			if (!Lower(presentTime > renderTime))
+				return;
+
+			//Back off from raising again if the last raise did not hold
+			if (lastChangeWasRaise && timeSinceChange < raiseDelay * 2)
+				raiseDelay = std::min(raiseDelay * 2, maxRaiseDelay);
+			else
+				raiseDelay = minRaiseDelay;
+
+			lastChangeWasRaise = false;
+			timeSinceChange = 0;
+			Apply();
+		}
+		else if (cost < budget * headroom && !steps.empty() && timeSinceChange >= raiseDelay)
+		{
+			Raise();
+			lastChangeWasRaise = true;
+			timeSinceChange = 0;
+			Apply();
+		}
+	}
+
+	//Get the settings currently in use
+	QualitySettings QualityController::GetSettings()
+	{
+		return settings;
+	}
+
+	//Get how far down from full quality the settings are, 0 is full quality
+	int QualityController::GetLevel()
+	{
+		return (int)steps.size();
+	}
+
+	//Get the average render time in seconds over the last measurement period
+	double QualityController::GetRenderTime()
+	{
+		return renderTime;
+	}
+
+	//Get the average present time in seconds over the last measurement period
+	double QualityController::GetPresentTime()
+	{
+		return presentTime;
+	}
+
+	//Get a short description of the current settings for displaying
+	std::string QualityController::Describe()
+	{
+		if (steps.empty())
+			return "Quality: full";
+
+		std::string description = "Quality: -" + std::to_string(steps.size());
+		if (settings.colorMode == ColorMode::Palette256)
+			description += ", 256 colors";
+		else if (settings.colorMode == ColorMode::Palette16)
+			description += ", 16 colors";
+		if (settings.renderScale > 1)
+			description += ", 1/" + std::to_string(settings.renderScale) + " res";
+		if (!settings.textureSampling)
+			description += ", no textures";
+		return description;
+	}
+
+	//Lower the quality by one step, returns false if there is nothing left to lower
+	bool QualityController::Lower(bool presentBound)
+	{
+		//Palettes make the output smaller, the rest make rendering cheaper, resolution helps both
+		static constexpr Step presentOrder[] = { Step::Palette256, Step::Palette16, Step::HalfResolution, Step::NoTextures };
+		static constexpr Step renderOrder[] = { Step::NoTextures, Step::HalfResolution, Step::Palette256, Step::Palette16 };
+
+		for (Step step : presentBound ? presentOrder : renderOrder)
+		{
+			if (std::find(steps.begin(), steps.end(), step) != steps.end())
+				continue;
+			//The 16 color palette only comes after the 256 one
+			if (step == Step::Palette16 && std::find(steps.begin(), steps.end(), Step::Palette256) == steps.end())
+				continue;
+
+			switch (step)
+			{
+			case Step::Palette256:
+				settings.colorMode = ColorMode::Palette256;
+				break;
+			case Step::Palette16:
+				settings.colorMode = ColorMode::Palette16;
+				break;
+			case Step::NoTextures:
+				settings.textureSampling = false;
+				break;
+			case Step::HalfResolution:
+				settings.renderScale = 2;
+				break;
+			}
+			steps.push_back(step);
+			return true;
+		}
+		return false;
+	}
+
+	//Undo the last step
+	void QualityController::Raise()
+	{
+		Step step = steps.back();
+		steps.pop_back();
+
+		switch (step)
+		{
+		case Step::Palette256:
+			settings.colorMode = ColorMode::TrueColor;
+			break;
+		case Step::Palette16:
+			settings.colorMode = ColorMode::Palette256;
+			break;
+		case Step::NoTextures:
+			settings.textureSampling = true;
+			break;
+		case Step::HalfResolution:
+			settings.renderScale = 1;
+			break;
+		}
+	}
+
+	//Apply the current settings to the window and rasterizer
+	void QualityController::Apply()
+	{
+		//Changing encoder settings forces a full redraw, so only do it when needed
+		EncoderSettings encoderSettings = window->GetEncoderSettings();
+		if (encoderSettings.colorMode != settings.colorMode)
+		{
+			encoderSettings.colorMode = settings.colorMode;
+			window->SetEncoderSettings(encoderSettings);
+		}
+
+		window->SetRenderScale(settings.renderScale);
+		enableTextureSampling = settings.textureSampling;
+	}
+}
\ No newline at end of file
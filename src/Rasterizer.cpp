@@ -1,11 +1,571 @@
 #include <cvid/Rasterizer.h>
 #include <cvid/Math.h>
 #include <cvid/Types.h>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#define CVID_AVX2
+#include <immintrin.h>
+#endif
 
 #define SWAP(a, b) {auto tmp = a; a = b; b = tmp;}
 
 namespace cvid
 {
+	//Width and height of the blocks of pixels the tiled rasterizer accepts or rejects at once
+	constexpr int tileSize = 8;
+	//Most pixels shaded before handing them to the window, spans longer than this are split
+	constexpr int spanChunk = 64;
+
+	//Fraction bits of the fixed point positions triangles are set up in, vertices are snapped to 1/16 of a pixel
+	constexpr int subpixelBits = 4;
+
+	//Buffers the line rasterizer reuses, so drawing does not allocate once they have grown
+	//One set per thread, so lines can be drawn on several threads at once
+	struct LineScratch
+	{
+		std::vector<double> zPositions;
+	};
+	static thread_local LineScratch lineScratch;
+
+	//The whole area of a window triangles can be drawn to
+	static inline PixelRect RenderRect(Window* window)
+	{
+		Vector2Int renderSize = window->GetRenderSize();
+		return { 0, 0, (int)renderSize.x - 1, (int)renderSize.y - 1 };
+	}
+
+	//Light a color by an intensity, channels are clamped to 255
+	static inline Color LightColor(Color color, double intensity)
+	{
+		color.r = std::min(intensity * color.r, 255.0);
+		color.g = std::min(intensity * color.g, 255.0);
+		color.b = std::min(intensity * color.b, 255.0);
+		return color;
+	}
+
+	//Get the texel a texture coordinate divided by depth lands on, z is the inverse depth
+	static inline Color SampleTexel(Texture* texture, Vector2 texCoord, double z)
+	{
+		Vector2Int sampleCoord(std::round((texCoord.x / z) * (texture->width - 1)), std::round((texCoord.y / z) * (texture->height - 1)));
+		return texture->GetTexel(sampleCoord);
+	}
+
+	//Sample a texel and light it unless it is unlit
+	template<bool lit>
+	static inline Color ShadeTexel(Texture* texture, Vector2 texCoord, double z, double intensity)
+	{
+		Color texel = SampleTexel(texture, texCoord, z);
+		if constexpr (lit)
+			return LightColor(texel, intensity);
+		else
+			return texel;
+	}
+
+#ifdef CVID_AVX2
+	static_assert(sizeof(Vector2) == 2 * sizeof(double), "Texture coordinates are loaded as pairs of doubles");
+
+	//std::round of four doubles, halfway values go away from zero unlike with _mm256_round_pd
+	static inline __m256d RoundHalfAway(__m256d value)
+	{
+		__m256d truncated = _mm256_round_pd(value, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+		__m256d signBit = _mm256_set1_pd(-0.0);
+		//The fraction is exact, one is added away from zero if it is at least a half
+		__m256d fraction = _mm256_andnot_pd(signBit, _mm256_sub_pd(value, truncated));
+		__m256d roundAway = _mm256_cmp_pd(fraction, _mm256_set1_pd(0.5), _CMP_GE_OQ);
+		__m256d one = _mm256_or_pd(_mm256_and_pd(value, signBit), _mm256_set1_pd(1.0));
+		return _mm256_blendv_pd(truncated, _mm256_add_pd(truncated, one), roundAway);
+	}
+
+	//Light one channel of four colors, shift is the bit position of the channel
+	static inline __m128i LightChannel(__m128i colors, int shift, __m256d intensity)
+	{
+		__m128i channel = _mm_and_si128(_mm_srl_epi32(colors, _mm_cvtsi32_si128(shift)), _mm_set1_epi32(0xff));
+		//Operands in the order of std::min so NaN and ties come out the same
+		__m256d lit = _mm256_min_pd(_mm256_set1_pd(255.0), _mm256_mul_pd(intensity, _mm256_cvtepi32_pd(channel)));
+		return _mm_sll_epi32(_mm_and_si128(_mm256_cvttpd_epi32(lit), _mm_set1_epi32(0xff)), _mm_cvtsi32_si128(shift));
+	}
+
+	//Sample and light four texels with one gather, returns false to do them one at a time if any is outside the texture
+	template<bool lit>
+	static inline bool ShadeTexels(Texture* texture, const Vector2* texCoords, __m256d z, double intensity, Color* out)
+	{
+		//Split the coordinates into xs and ys
+		__m256d a = _mm256_loadu_pd((const double*)texCoords);
+		__m256d b = _mm256_loadu_pd((const double*)(texCoords + 2));
+		__m256d u = _mm256_permute4x64_pd(_mm256_unpacklo_pd(a, b), 0xd8);
+		__m256d v = _mm256_permute4x64_pd(_mm256_unpackhi_pd(a, b), 0xd8);
+
+		//Same operations as SampleTexel, out of range and NaN coordinates become INT32_MIN which is outside
+		u = RoundHalfAway(_mm256_mul_pd(_mm256_div_pd(u, z), _mm256_set1_pd(texture->width - 1)));
+		v = RoundHalfAway(_mm256_mul_pd(_mm256_div_pd(v, z), _mm256_set1_pd(texture->height - 1)));
+		__m128i x = _mm256_cvttpd_epi32(u);
+		__m128i y = _mm256_cvttpd_epi32(v);
+
+		__m128i outside = _mm_or_si128(_mm_or_si128(_mm_cmplt_epi32(x, _mm_setzero_si128()), _mm_cmplt_epi32(y, _mm_setzero_si128())),
+			_mm_or_si128(_mm_cmpgt_epi32(x, _mm_set1_epi32(texture->width - 1)), _mm_cmpgt_epi32(y, _mm_set1_epi32(texture->height - 1))));
+		if (!_mm_testz_si128(outside, outside))
+			return false;
+
+		__m128i index = _mm_add_epi32(_mm_mullo_epi32(y, _mm_set1_epi32(texture->width)), x);
+		__m128i texels = _mm_i32gather_epi32((const int*)texture->data.data(), index, sizeof(Color));
+
+		if constexpr (lit)
+		{
+			//Alpha is kept as it is
+			__m256d scale = _mm256_set1_pd(intensity);
+			__m128i litTexels = _mm_and_si128(texels, _mm_set1_epi32((int)0xff000000));
+			litTexels = _mm_or_si128(litTexels, LightChannel(texels, 0, scale));
+			litTexels = _mm_or_si128(litTexels, LightChannel(texels, 8, scale));
+			litTexels = _mm_or_si128(litTexels, LightChannel(texels, 16, scale));
+			_mm_storeu_si128((__m128i*)out, litTexels);
+		}
+		else
+		{
+			_mm_storeu_si128((__m128i*)out, texels);
+		}
+		return true;
+	}
+#endif
+
+	//Shade a row of count pixels starting at x, y and draw them, four at a time with AVX2
+	//z is the interpolated inverse depth of each pixel and texCoords the texture coordinates divided by depth, only read if textured
+	//Compiled for textured or flat and lit or unlit pixels so the loops do not branch on them, flat pixels are all the lit color
+	template<bool textured, bool lit>
+	static void ShadeSpan(Window* window, int x, int y, int count, const double* z, const Vector2* texCoords, Texture* texture, Color color, double intensity)
+	{
+		Color colors[spanChunk];
+		double depths[spanChunk];
+		//Without a texture every pixel is the same color
+		if constexpr (!textured)
+			std::fill_n(colors, std::min(count, spanChunk), lit ? LightColor(color, intensity) : color);
+
+		for (int start = 0; start < count; start += spanChunk)
+		{
+			int chunk = std::min(spanChunk, count - start);
+			const double* chunkZ = z + start;
+			int i = 0;
+#ifdef CVID_AVX2
+			for (; i + 4 <= chunk; i += 4)
+			{
+				__m256d zs = _mm256_loadu_pd(chunkZ + i);
+				_mm256_storeu_pd(depths + i, _mm256_div_pd(_mm256_set1_pd(1.0), zs));
+				if constexpr (textured)
+				{
+					if (!ShadeTexels<lit>(texture, texCoords + start + i, zs, intensity, colors + i))
+					{
+						for (int lane = i; lane < i + 4; lane++)
+							colors[lane] = ShadeTexel<lit>(texture, texCoords[start + lane], chunkZ[lane], intensity);
+					}
+				}
+			}
+#endif
+			for (; i < chunk; i++)
+			{
+				depths[i] = 1 / chunkZ[i];
+				if constexpr (textured)
+					colors[i] = ShadeTexel<lit>(texture, texCoords[start + i], chunkZ[i], intensity);
+			}
+
+			window->PutSpan(x + start, y, chunk, colors, depths);
+		}
+	}
+
+	//Snap a coordinate to the fixed point triangles are set up in
+	static inline int64_t ToFixed(double value)
+	{
+		return std::llround(value * (1 << subpixelBits));
+	}
+
+	//Divide rounding towards negative infinity, divisor must be positive
+	static inline int64_t FloorDiv(int64_t dividend, int64_t divisor)
+	{
+		int64_t quotient = dividend / divisor;
+		return quotient - (dividend % divisor < 0);
+	}
+
+	//An edge of a triangle as E(x, y) = a * x + b * y + c in fixed point, positive on the inside of a counterclockwise triangle
+	struct EdgeFunction
+	{
+		int64_t a;
+		int64_t b;
+		int64_t c;
+		//Added before testing, pixels exactly on an edge are only inside for top and left edges
+		//Triangles sharing an edge go along it in opposite directions, so exactly one of them draws the pixels on it
+		int64_t bias;
+
+		EdgeFunction() = default;
+		EdgeFunction(Vector2Int from, Vector2Int to)
+		{
+			a = from.y - to.y;
+			b = to.x - from.x;
+			c = -(a * from.x + b * from.y);
+			bool topLeft = to.y < from.y || (to.y == from.y && to.x < from.x);
+			bias = topLeft ? 0 : -1;
+		}
+
+		//Value at a fixed point position
+		int64_t Value(Vector2Int point) const
+		{
+			return a * point.x + b * point.y + c;
+		}
+		//Value at the center of a pixel
+		int64_t At(int64_t x, int64_t y) const
+		{
+			return a * (x << subpixelBits) + b * (y << subpixelBits) + c;
+		}
+		//Change in value from one pixel to the next on a row
+		int64_t StepX() const
+		{
+			return a << subpixelBits;
+		}
+		//Change in value from one row to the next
+		int64_t StepY() const
+		{
+			return b << subpixelBits;
+		}
+	};
+
+	//A triangle snapped to fixed point, the scanline and tiled rasterizers fill exactly the same pixels of it
+	struct TriangleSetup
+	{
+		//The edge across from each vertex, its value over the area is the barycentric weight of the vertex
+		EdgeFunction edges[3];
+		double inverseArea;
+		//Pixels whose centers can be inside the triangle, within the clip rectangle
+		PixelRect bounds;
+	};
+
+	//An attribute of a triangle as a plane over the window, value(x, y) = origin + perX * x + perY * y
+	//Each pixel is evaluated on its own, so drawing a triangle in parts gives the same pixels as drawing it at once
+	struct AttributePlane
+	{
+		double origin;
+		double perX;
+		double perY;
+	};
+
+	//What the pixels of a triangle are shaded with, the attributes are divided by depth
+	struct TriangleShading
+	{
+		AttributePlane z;
+		AttributePlane u;
+		AttributePlane v;
+		//Null for flat shading
+		Texture* texture;
+		Color color;
+		double intensity;
+	};
+
+	//Snap a triangle to fixed point and set up its edges, returns false if it has no area or no pixels inside clip
+	static bool SetupTriangle(const Tri& verts, PixelRect clip, TriangleSetup& setup)
+	{
+		Vector2Int p[3] = { { ToFixed(verts.v0.x), ToFixed(verts.v0.y) }, { ToFixed(verts.v1.x), ToFixed(verts.v1.y) }, { ToFixed(verts.v2.x), ToFixed(verts.v2.y) } };
+		//Which vertex each edge belongs to, clockwise triangles are turned around
+		int order[3] = { 0, 1, 2 };
+		int64_t area = EdgeFunction(p[0], p[1]).Value(p[2]);
+		if (area == 0)
+			return false;
+		if (area < 0)
+		{
+			SWAP(p[1], p[2]);
+			SWAP(order[1], order[2]);
+			area = -area;
+		}
+
+		setup.edges[order[0]] = EdgeFunction(p[1], p[2]);
+		setup.edges[order[1]] = EdgeFunction(p[2], p[0]);
+		setup.edges[order[2]] = EdgeFunction(p[0], p[1]);
+		setup.inverseArea = 1.0 / area;
+
+		//Pixel centers are on whole coordinates, so the bounds round inwards
+		const int64_t roundUp = (1 << subpixelBits) - 1;
+		int64_t minX = std::max<int64_t>((std::min({ p[0].x, p[1].x, p[2].x }) + roundUp) >> subpixelBits, clip.minX);
+		int64_t minY = std::max<int64_t>((std::min({ p[0].y, p[1].y, p[2].y }) + roundUp) >> subpixelBits, clip.minY);
+		int64_t maxX = std::min<int64_t>(std::max({ p[0].x, p[1].x, p[2].x }) >> subpixelBits, clip.maxX);
+		int64_t maxY = std::min<int64_t>(std::max({ p[0].y, p[1].y, p[2].y }) >> subpixelBits, clip.maxY);
+		if (minX > maxX || minY > maxY)
+			return false;
+		setup.bounds = { (int)minX, (int)minY, (int)maxX, (int)maxY };
+		return true;
+	}
+
+	//The plane going through an attribute's value at each vertex
+	static AttributePlane MakePlane(const TriangleSetup& setup, double a0, double a1, double a2)
+	{
+		const EdgeFunction* edges = setup.edges;
+		AttributePlane plane;
+		plane.origin = (a0 * edges[0].c + a1 * edges[1].c + a2 * edges[2].c) * setup.inverseArea;
+		plane.perX = (a0 * edges[0].StepX() + a1 * edges[1].StepX() + a2 * edges[2].StepX()) * setup.inverseArea;
+		plane.perY = (a0 * edges[0].StepY() + a1 * edges[1].StepY() + a2 * edges[2].StepY()) * setup.inverseArea;
+		return plane;
+	}
+
+	//Evaluate a plane at count pixels of a row starting at x
+	static inline void InterpolateRow(const AttributePlane& plane, int x, int y, int count, double* values)
+	{
+		double row = plane.origin + plane.perY * y;
+		for (int i = 0; i < count; i++)
+			values[i] = row + plane.perX * (double)(x + i);
+	}
+
+	//Shade and draw count pixels of a row starting at x, at most chunkSize are interpolated at a time
+	template<int chunkSize, bool textured, bool lit>
+	static void DrawTriangleSpan(Window* window, const TriangleShading& shading, int x, int y, int count)
+	{
+		double z[chunkSize];
+		Vector2 texCoords[textured ? chunkSize : 1];
+		double rowU = shading.u.origin + shading.u.perY * y;
+		double rowV = shading.v.origin + shading.v.perY * y;
+
+		for (int chunkStart = 0; chunkStart < count; chunkStart += chunkSize)
+		{
+			int chunk = std::min(chunkSize, count - chunkStart);
+			InterpolateRow(shading.z, x + chunkStart, y, chunk, z);
+			if constexpr (textured)
+			{
+				for (int i = 0; i < chunk; i++)
+				{
+					double pixelX = x + chunkStart + i;
+					texCoords[i] = Vector2(rowU + shading.u.perX * pixelX, rowV + shading.v.perX * pixelX);
+				}
+			}
+			ShadeSpan<textured, lit>(window, x + chunkStart, y, chunk, z, texCoords, shading.texture, shading.color, shading.intensity);
+		}
+	}
+
+	//Draws a row of a triangle's pixels, each variant is compiled for one combination of features
+	using SpanFunction = void (*)(Window* window, const TriangleShading& shading, int x, int y, int count);
+	//Every DrawTriangleSpan variant for a chunk size, indexed [textured][lit]
+	template<int chunkSize>
+	constexpr SpanFunction spanVariants[2][2] = {
+		{ DrawTriangleSpan<chunkSize, false, false>, DrawTriangleSpan<chunkSize, false, true> },
+		{ DrawTriangleSpan<chunkSize, true, false>, DrawTriangleSpan<chunkSize, true, true> }
+	};
+
+	//Pick the DrawTriangleSpan variant for a triangle once, an intensity of exactly 1 leaves colors as they are so it is unlit
+	template<int chunkSize>
+	static inline SpanFunction PickSpanVariant(const TriangleShading& shading)
+	{
+		return spanVariants<chunkSize>[shading.texture != nullptr][shading.intensity != 1];
+	}
+
+	//Fill a triangle a row at a time, the pixel each edge crosses a row at is walked exactly as a quotient and remainder
+	//Calls plot(x, y, count) for every row of covered pixels
+	template<typename Plot>
+	static void RasterizeScanline(const TriangleSetup& setup, Plot plot)
+	{
+		//On a row a pixel x is inside an edge when a * x >= -(value at x = 0 + bias) in pixel steps
+		//Edges with a positive a bound x from the left and negative from the right, each bound being limit / divisor
+		struct EdgeWalk
+		{
+			int64_t quotient;
+			int64_t remainder;
+			int64_t divisor;
+			int64_t quotientStep;
+			int64_t remainderStep;
+		};
+		EdgeWalk walks[3];
+		int64_t rowStart[3];
+		for (int i = 0; i < 3; i++)
+		{
+			const EdgeFunction& edge = setup.edges[i];
+			rowStart[i] = edge.At(0, setup.bounds.minY);
+			if (edge.a == 0)
+				continue;
+
+			int64_t limit = rowStart[i] + edge.bias;
+			int64_t limitStep = edge.StepY();
+			if (edge.a > 0)
+			{
+				limit = -limit;
+				limitStep = -limitStep;
+			}
+			EdgeWalk& walk = walks[i];
+			walk.divisor = std::abs(edge.StepX());
+			walk.quotient = FloorDiv(limit, walk.divisor);
+			walk.remainder = limit - walk.quotient * walk.divisor;
+			walk.quotientStep = FloorDiv(limitStep, walk.divisor);
+			walk.remainderStep = limitStep - walk.quotientStep * walk.divisor;
+		}
+
+		for (int y = setup.bounds.minY; y <= setup.bounds.maxY; y++)
+		{
+			int64_t left = setup.bounds.minX;
+			int64_t right = setup.bounds.maxX;
+			for (int i = 0; i < 3; i++)
+			{
+				const EdgeFunction& edge = setup.edges[i];
+				//A horizontal edge is either inside the whole row or none of it
+				if (edge.a == 0)
+				{
+					if (rowStart[i] + edge.bias < 0)
+						right = left - 1;
+				}
+				else if (edge.a > 0)
+					left = std::max(left, walks[i].quotient + (walks[i].remainder != 0));
+				else
+					right = std::min(right, walks[i].quotient);
+			}
+
+			if (left <= right)
+				plot((int)left, y, (int)(right - left + 1));
+
+			//Step every edge down a row
+			for (int i = 0; i < 3; i++)
+			{
+				rowStart[i] += setup.edges[i].StepY();
+				if (setup.edges[i].a == 0)
+					continue;
+				EdgeWalk& walk = walks[i];
+				walk.quotient += walk.quotientStep;
+				walk.remainder += walk.remainderStep;
+				if (walk.remainder >= walk.divisor)
+				{
+					walk.quotient++;
+					walk.remainder -= walk.divisor;
+				}
+			}
+		}
+	}
+
+	//Fill a triangle by testing tiles of pixels against its edge functions
+	//Calls plot(x, y, count) for every row of covered pixels, joined across the tiles of a row of tiles so large triangles are not drawn in pieces
+	template<typename Plot>
+	static void RasterizeTiled(const TriangleSetup& setup, Plot plot)
+	{
+		const EdgeFunction* edges = setup.edges;
+		const PixelRect& bounds = setup.bounds;
+
+		//From a tile's corner to the corner where each edge function is highest and lowest
+		int64_t rejectOffset[3];
+		int64_t acceptOffset[3];
+		for (int i = 0; i < 3; i++)
+		{
+			rejectOffset[i] = (std::max<int64_t>(edges[i].StepX(), 0) + std::max<int64_t>(edges[i].StepY(), 0)) * (tileSize - 1) + edges[i].bias;
+			acceptOffset[i] = (std::min<int64_t>(edges[i].StepX(), 0) + std::min<int64_t>(edges[i].StepY(), 0)) * (tileSize - 1) + edges[i].bias;
+		}
+
+		//The span of each row in the current row of tiles, plotted once the row of tiles is done
+		int spanStart[tileSize];
+		int spanCount[tileSize];
+
+		//The tiles stay aligned to the window so clipping does not change which pixels are drawn
+		for (int tileY = bounds.minY & ~(tileSize - 1); tileY <= bounds.maxY; tileY += tileSize)
+		{
+			int startY = std::max(tileY, bounds.minY);
+			int endY = std::min(tileY + tileSize - 1, bounds.maxY);
+			std::fill_n(spanCount, tileSize, 0);
+
+			for (int tileX = bounds.minX & ~(tileSize - 1); tileX <= bounds.maxX; tileX += tileSize)
+			{
+				int64_t corner[3] = { edges[0].At(tileX, tileY), edges[1].At(tileX, tileY), edges[2].At(tileX, tileY) };
+
+				//Skip the tile if it is entirely outside any edge
+				if (corner[0] + rejectOffset[0] < 0 || corner[1] + rejectOffset[1] < 0 || corner[2] + rejectOffset[2] < 0)
+					continue;
+				//Every pixel is covered if the tile is entirely inside every edge
+				bool covered = corner[0] + acceptOffset[0] >= 0 && corner[1] + acceptOffset[1] >= 0 && corner[2] + acceptOffset[2] >= 0;
+
+				//Tiles on the border of the bounding box are only partly drawn
+				int startX = std::max(tileX, bounds.minX);
+				int endX = std::min(tileX + tileSize - 1, bounds.maxX);
+				for (int y = startY; y <= endY; y++)
+				{
+					int spanX = startX;
+					int count = endX - startX + 1;
+					if (!covered)
+					{
+						int64_t row[3] = { edges[0].At(startX, y), edges[1].At(startX, y), edges[2].At(startX, y) };
+						count = 0;
+						for (int x = startX; x <= endX; x++)
+						{
+							if (((row[0] + edges[0].bias) | (row[1] + edges[1].bias) | (row[2] + edges[2].bias)) >= 0)
+							{
+								if (count == 0)
+									spanX = x;
+								count++;
+							}
+
+							row[0] += edges[0].StepX();
+							row[1] += edges[1].StepX();
+							row[2] += edges[2].StepX();
+						}
+						if (count == 0)
+							continue;
+					}
+
+					//A row of a triangle is never split, so its pixels in this tile carry on from those in the tile before
+					int& start = spanStart[y - tileY];
+					int& pending = spanCount[y - tileY];
+					if (pending > 0 && start + pending == spanX)
+					{
+						pending += count;
+					}
+					else
+					{
+						if (pending > 0)
+							plot(start, y, pending);
+						start = spanX;
+						pending = count;
+					}
+				}
+			}
+
+			for (int y = startY; y <= endY; y++)
+			{
+				if (spanCount[y - tileY] > 0)
+					plot(spanStart[y - tileY], y, spanCount[y - tileY]);
+			}
+		}
+	}
+
+	//Fill a set up triangle with the rasterizer picked by rasterMode
+	static void FillTriangle(Window* window, const TriangleSetup& setup, const TriangleShading& shading)
+	{
+		SpanFunction drawSpan = PickSpanVariant<spanChunk>(shading);
+		auto plot = [&](int x, int y, int count)
+			{
+				drawSpan(window, shading, x, y, count);
+			};
+		if (rasterMode == RasterMode::Tiled)
+			RasterizeTiled(setup, plot);
+		else
+			RasterizeScanline(setup, plot);
+	}
+
+	//Interpolate what a set up face is shaded with across it
+	static TriangleShading MakeShading(const TriangleSetup& setup, const VisibleFace& lit)
+	{
+		const Face& tri = lit.face;
+		//Correct for perspective correct interpolation
+		double z0 = 1.0 / tri.vertices.v0.z;
+		double z1 = 1.0 / tri.vertices.v1.z;
+		double z2 = 1.0 / tri.vertices.v2.z;
+		TriangleShading shading;
+		shading.z = MakePlane(setup, z0, z1, z2);
+		shading.texture = lit.texture;
+		if (shading.texture)
+		{
+			shading.u = MakePlane(setup, tri.texCoords.v0.x * z0, tri.texCoords.v1.x * z1, tri.texCoords.v2.x * z2);
+			shading.v = MakePlane(setup, tri.texCoords.v0.y * z0, tri.texCoords.v1.y * z1, tri.texCoords.v2.y * z2);
+		}
+		shading.color = lit.color;
+		shading.intensity = lit.intensity;
+		return shading;
+	}
+
+	//Faces ShadeVisibility has interpolated, and the call each was done in, so each is set up once per call
+	//One set per thread, so bands of rows can be shaded on several threads at once
+	struct VisibilityScratch
+	{
+		std::vector<TriangleShading> shadings;
+		std::vector<uint32_t> preparedIn;
+		uint32_t call = 0;
+	};
+	static thread_local VisibilityScratch visibilityScratch;
+
 	//Difference between two attributes
 	inline Attributes AttribChangePerD(Attributes a, Attributes b, int d)
 	{
@@ -44,7 +604,8 @@ namespace cvid
 			}
 
 			//Interpolate for z positions
-			std::vector<double> zPositions = LerpRange(p1.x, p0.x, 1 / v0.z, 1 / v1.z);
+			std::vector<double>& zPositions = lineScratch.zPositions;
+			LerpRange(p1.x, p0.x, 1 / v0.z, 1 / v1.z, zPositions);
 
 			dx = p1.x - p0.x;
 			dy = p1.y - p0.y;
@@ -89,7 +650,8 @@ namespace cvid
 			}
 
 			//Interpolate for z positions
-			std::vector<double> zPositions = LerpRange(p1.y, p0.y, 1 / v0.z, 1 / v1.z);
+			std::vector<double>& zPositions = lineScratch.zPositions;
+			LerpRange(p1.y, p0.y, 1 / v0.z, 1 / v1.z, zPositions);
 
 			dx = p1.x - p0.x;
 			dy = p1.y - p0.y;
@@ -127,16 +689,28 @@ namespace cvid
 
 	//Interpolate vertex attributes for each position between start and end (inclusive), left or right edge is prioritized
 	std::vector<Attributes> InterpolateAttributes(Vector2Int start, Vector2Int end, Attributes a, Attributes b, bool prioritizeLeft)
+	{
+		std::vector<Attributes> results;
+		InterpolateAttributes(start, end, a, b, prioritizeLeft, results);
+		return results;
+	}
+
+	//Interpolate vertex attributes for each position between start and end (inclusive) into results, replacing what it had
+	//Does not allocate once results is big enough, so the same vector can be reused every triangle
+	void InterpolateAttributes(Vector2Int start, Vector2Int end, Attributes a, Attributes b, bool prioritizeLeft, std::vector<Attributes>& results)
 	{
 		int dx = end.x - start.x;
 		int dy = end.y - start.y;
 
+		results.clear();
 		//Can't interpolate a horizontal line
 		if (dy == 0)
-			return { b };
+		{
+			results.push_back(b);
+			return;
+		}
 
-		std::vector<Attributes> results;
-		results.reserve(abs(dy));
+		results.reserve(abs(dy) + 1);
 
 		//Right and leftmost interpolated attributes for the y or x position
 		Attributes rAttrib = a;
@@ -231,162 +805,152 @@ namespace cvid
 			else
 				results.push_back(rAttrib);
 		}
-
-		return results;
 	}
 
 	//Draw a triangle onto a window's framebuffer
 	//Expects vertices in normalized device coordinates
 	void RasterizeTriangle(Window* window, Face tri, const Material* mat)
 	{
-		//Calculate flat shading for this tri
-		double n = tri.normal.Dot(directionalLight) / tri.normal.Length() * directionalLight.Length();
-		double intensity = ambientLightIntensity + directionalLightIntensity * n;
+		RasterizeTriangle(window, tri, mat, RenderRect(window));
+	}
 
-		Color color = mat != nullptr ? mat->diffuseColor : Color();
+	//Draw the part of a triangle inside clip, which must be inside the window
+	//Every pixel is interpolated from the whole triangle, so drawing it in parts gives the same pixels as drawing it at once
+	void RasterizeTriangle(Window* window, Face tri, const Material* mat, PixelRect clip)
+	{
+		TriangleSetup setup;
+		if (!SetupTriangle(tri.vertices, clip, setup))
+			return;
+		FillTriangle(window, setup, MakeShading(setup, LightFace(tri, mat)));
+	}
 
-		//Get the points and attributes from the tri
-		Vector2Int p0 = tri.vertices.v0;
-		Vector2Int p1 = tri.vertices.v1;
-		Vector2Int p2 = tri.vertices.v2;
-		//Correct for perspective correct interpolation
-		Attributes a0 = { std::lroundf(tri.vertices.v0.x), 1.0 / tri.vertices.v0.z, tri.texCoords.v0 / tri.vertices.v0.z };
-		Attributes a1 = { std::lroundf(tri.vertices.v1.x), 1.0 / tri.vertices.v1.z, tri.texCoords.v1 / tri.vertices.v1.z };
-		Attributes a2 = { std::lroundf(tri.vertices.v2.x), 1.0 / tri.vertices.v2.z, tri.texCoords.v2 / tri.vertices.v2.z };
+	//Draw a triangle onto a window's framebuffer entirely of one color
+	void RasterizeTriangle(Window* window, Tri verts, Color color)
+	{
+		RasterizeTriangle(window, verts, color, RenderRect(window));
+	}
 
-		//Sort the vertices in vertically descending order
-		if (p0.y < p1.y)
-		{
-			SWAP(p0, p1);
-			SWAP(a0, a1);
-		}
-		if (p0.y < p2.y)
-		{
-			SWAP(p0, p2);
-			SWAP(a0, a2);
-		}
-		if (p1.y < p2.y)
-		{
-			SWAP(p1, p2);
-			SWAP(a1, a2);
-		}
+	//Draw the part of a triangle entirely of one color inside clip, which must be inside the window
+	void RasterizeTriangle(Window* window, Tri verts, Color color, PixelRect clip)
+	{
+		TriangleSetup setup;
+		if (!SetupTriangle(verts, clip, setup))
+			return;
+
+		//Untextured and unlit, shading only turns the inverse depths into depths
+		VisibleFace flat;
+		flat.face.vertices = verts;
+		flat.color = color;
+		FillTriangle(window, setup, MakeShading(setup, flat));
+	}
 
-		//If p2 is to the left of p1 or p3, the full segment will be on the right
-		Vector2 v1 = Vector2(p1 - p0).Normalize();
-		Vector2 v2 = Vector2(p2 - p0).Normalize();
-		bool fullOnRight = v1.x < v2.x;
-
-		//Interpolate the vertex attributes for each side (x, z, texCoord)
-		std::vector<Attributes> combinedSegment = InterpolateAttributes(p2, p1, a2, a1, fullOnRight);
-		std::vector<Attributes> shortSegment = InterpolateAttributes(p1, p0, a1, a0, fullOnRight);
-		std::vector<Attributes> fullSegment = InterpolateAttributes(p2, p0, a2, a0, !fullOnRight);
-		combinedSegment.insert(combinedSegment.end(), shortSegment.begin() + 1, shortSegment.end());
-
-		//Figure out which segment is on which side
-		std::vector<Attributes>* rightSegment = &combinedSegment;
-		std::vector<Attributes>* leftSegment = &fullSegment;
-		//If the full segment is on the right side, swap the segments
-		if (fullOnRight)
-		{
-			rightSegment = &fullSegment;
-			leftSegment = &combinedSegment;
-		}
+	//Get what a face is shaded with under the current lights and texture sampling setting
+	VisibleFace LightFace(const Face& face, const Material* mat)
+	{
+		VisibleFace lit;
+		lit.face = face;
 
-		int startY = (int)std::round(p2.y);
-		//For each y coordinate in the triangle
-		for (int yi = 0; yi < fullSegment.size(); yi++)
-		{
-			//Interpolate for z positions for each horizontal scanline
-			std::vector<double> zPositions = LerpRange(leftSegment->at(yi).x, rightSegment->at(yi).x, leftSegment->at(yi).z, rightSegment->at(yi).z);
-			//Interpolate texture coordinates if applicable
-			std::vector<Vector2> texCoords;
-			if (mat) if (mat->texture)
-				texCoords = LerpRange2D(leftSegment->at(yi).x, rightSegment->at(yi).x, leftSegment->at(yi).texCoord, rightSegment->at(yi).texCoord);
-
-			//Draw a line from the full segment to the split segment
-			int startX = leftSegment->at(yi).x;
-			for (int xi = 0; xi <= rightSegment->at(yi).x - leftSegment->at(yi).x; xi++)
+		//Calculate flat shading for this tri
+		double n = face.normal.Dot(directionalLight) / face.normal.Length() * directionalLight.Length();
+		lit.intensity = ambientLightIntensity + directionalLightIntensity * n;
+
+		lit.color = mat != nullptr ? mat->diffuseColor : Color();
+		//Without sampling a texture is flat shaded with its average color
+		if (mat && mat->texture && enableTextureSampling)
+			lit.texture = mat->texture.get();
+		if (mat && mat->texture && !enableTextureSampling)
+			lit.color = mat->texture->averageColor;
+		return lit;
+	}
+
+	//Store id in the window's visibility buffer for the pixels of a triangle inside clip which pass the depth test, the colors are left as they are
+	void RasterizeTriangleVisibility(Window* window, Tri verts, uint32_t id, PixelRect clip)
+	{
+		TriangleSetup setup;
+		if (!SetupTriangle(verts, clip, setup))
+			return;
+
+		//The same depths shading the triangle gives, so shading it later passes the depth test wherever this did
+		AttributePlane z = MakePlane(setup, 1.0 / verts.v0.z, 1.0 / verts.v1.z, 1.0 / verts.v2.z);
+		auto plot = [&](int x, int y, int count)
 			{
-				Color renderColor = color;
-				//Get the color from the texture if it exists
-				if (!texCoords.empty())
+				double depths[spanChunk];
+				for (int start = 0; start < count; start += spanChunk)
 				{
-					Vector2Int sampleCoord(std::round((texCoords[xi].x / zPositions[xi]) * (mat->texture->width - 1)), std::round((texCoords[xi].y / zPositions[xi]) * (mat->texture->height - 1)));
-					renderColor = mat->texture->GetTexel(sampleCoord);
+					int chunk = std::min(spanChunk, count - start);
+					InterpolateRow(z, x + start, y, chunk, depths);
+					for (int i = 0; i < chunk; i++)
+						depths[i] = 1 / depths[i];
+					window->PutVisibilitySpan(x + start, y, chunk, id, depths);
 				}
-				renderColor.r = std::min(intensity * renderColor.r, 255.0);
-				renderColor.g = std::min(intensity * renderColor.g, 255.0);
-				renderColor.b = std::min(intensity * renderColor.b, 255.0);
-
-				//Attempt to draw the pixel
-				window->PutPixel(startX + xi, startY + yi, renderColor, 1 / zPositions[xi]);
-			}
-		}
+			};
+		if (rasterMode == RasterMode::Tiled)
+			RasterizeTiled(setup, plot);
+		else
+			RasterizeScanline(setup, plot);
 	}
 
-	//Draw a triangle onto a window's framebuffer entirely of one color
-	void RasterizeTriangle(Window* window, Tri verts, Color color)
+	//Make room in this thread's scratch for ShadeVisibility to set up some amount of faces, so shading them does not allocate
+	void ReserveShadeVisibility(size_t numFaces)
 	{
-		//Get the points and attributes from the tri
-		Vector2Int p0 = verts.v0;
-		Vector2Int p1 = verts.v1;
-		Vector2Int p2 = verts.v2;
-		//Correct for perspective correct interpolation
-		Attributes a0 = { std::lroundf(verts.v0.x), 1.0 / verts.v0.z, 0 };
-		Attributes a1 = { std::lroundf(verts.v1.x), 1.0 / verts.v1.z, 0 };
-		Attributes a2 = { std::lroundf(verts.v2.x), 1.0 / verts.v2.z, 0 };
-
-		//Sort the vertices in vertically descending order
-		if (p0.y < p1.y)
-		{
-			SWAP(p0, p1);
-			SWAP(a0, a1);
-		}
-		if (p0.y < p2.y)
+		VisibilityScratch& scratch = visibilityScratch;
+		if (scratch.shadings.size() < numFaces)
 		{
-			SWAP(p0, p2);
-			SWAP(a0, a2);
-		}
-		if (p1.y < p2.y)
-		{
-			SWAP(p1, p2);
-			SWAP(a1, a2);
+			scratch.shadings.resize(numFaces);
+			scratch.preparedIn.resize(numFaces, 0);
 		}
+	}
 
-		//If p2 is to the left of p1 or p3, the full segment will be on the right
-		Vector2 v1 = Vector2(p1 - p0).Normalize();
-		Vector2 v2 = Vector2(p2 - p0).Normalize();
-		bool fullOnRight = v1.x < v2.x;
-
-		//Interpolate the vertex attributes for each side (x, z, texCoord)
-		std::vector<Attributes> combinedSegment = InterpolateAttributes(p2, p1, a2, a1, fullOnRight);
-		std::vector<Attributes> shortSegment = InterpolateAttributes(p1, p0, a1, a0, fullOnRight);
-		std::vector<Attributes> fullSegment = InterpolateAttributes(p2, p0, a2, a0, !fullOnRight);
-		combinedSegment.insert(combinedSegment.end(), shortSegment.begin() + 1, shortSegment.end());
-
-		//Figure out which segment is on which side
-		std::vector<Attributes>* rightSegment = &combinedSegment;
-		std::vector<Attributes>* leftSegment = &fullSegment;
-		//If the full segment is on the right side, swap the segments
-		if (fullOnRight)
+	//Shade the rows from minY to maxY of a window's visibility buffer, each pixel once with the face stored there
+	void ShadeVisibility(Window* window, int minY, int maxY)
+	{
+		const std::vector<VisibleFace>& faces = window->GetVisibleFaces();
+		if (faces.empty())
+			return;
+
+		//Faces are set up the first time one of their pixels comes up
+		//Sized for all the window has room for rather than how many there are, so this only grows along with it
+		ReserveShadeVisibility(faces.capacity());
+		VisibilityScratch& scratch = visibilityScratch;
+		if (++scratch.call == 0)
 		{
-			rightSegment = &fullSegment;
-			leftSegment = &combinedSegment;
+			std::fill(scratch.preparedIn.begin(), scratch.preparedIn.end(), 0);
+			scratch.call = 1;
 		}
 
-		int startY = (int)std::round(p2.y);
-		//For each y coordinate in the triangle
-		for (int yi = 0; yi < fullSegment.size(); yi++)
+		PixelRect renderRect = RenderRect(window);
+		minY = std::max(minY, renderRect.minY);
+		maxY = std::min(maxY, renderRect.maxY);
+		for (int y = minY; y <= maxY; y++)
 		{
-			//Interpolate for z positions for each horizontal scanline
-			std::vector<double> zPositions = LerpRange(leftSegment->at(yi).x, rightSegment->at(yi).x, leftSegment->at(yi).z, rightSegment->at(yi).z);
+			const uint32_t* ids = window->GetVisibilityRow(y);
+			if (!ids)
+				return;
 
-			//Draw a line from the full segment to the split segment
-			int startX = leftSegment->at(yi).x;
-			for (int xi = 0; xi <= rightSegment->at(yi).x - leftSegment->at(yi).x; xi++)
+			//Shade each run of pixels of the same face together
+			for (int x = 0; x <= renderRect.maxX;)
 			{
-				//Attempt to draw the pixel
-				window->PutPixel(startX + xi, startY + yi, color, zPositions[xi]);
+				uint32_t id = ids[x];
+				int end = x + 1;
+				while (end <= renderRect.maxX && ids[end] == id)
+					end++;
+
+				if (id != 0 && id <= faces.size())
+				{
+					TriangleShading& shading = scratch.shadings[id - 1];
+					if (scratch.preparedIn[id - 1] != scratch.call)
+					{
+						TriangleSetup setup;
+						if (SetupTriangle(faces[id - 1].face.vertices, renderRect, setup))
+						{
+							shading = MakeShading(setup, faces[id - 1]);
+							scratch.preparedIn[id - 1] = scratch.call;
+						}
+					}
+					if (scratch.preparedIn[id - 1] == scratch.call)
+						PickSpanVariant<spanChunk>(shading)(window, shading, x, y, end - x);
+				}
+				x = end;
 			}
 		}
 	}
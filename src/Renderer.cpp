@@ -1,10 +1,162 @@
 #include <bitset>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+#include <climits>
 #include <cvid/Renderer.h>
 #include <cvid/Rasterizer.h>
+#include <cvid/ThreadPool.h>
 #include <cvid/Math.h>
 
 namespace cvid
 {
+	//Most triangles clipping one triangle against all five planes can make, each plane at most doubles them
+	constexpr size_t maxClippedFaces = 32;
+	//Rows of render pixels in each band faces are sorted into when drawing on several threads
+	//Pixels are evaluated on their own so any split draws the same, bands go across the whole window since a face is set up again in every bin it touches
+	//An even height keeps both pixels of a character in one band, so no two threads ever write to the same character
+	constexpr int bandHeight = 8;
+
+	//Buffers DrawModel reuses for every model, so drawing does not allocate once they have grown
+	//One set per thread, so models can be drawn on several threads at once
+	struct ModelScratch
+	{
+		std::vector<Vertex> vertices;
+		std::vector<bool> culled;
+		std::vector<Vector3> normals;
+		std::vector<Face> faces;
+		//Faces in screen space in the order they were submitted with the pixels they can cover
+		std::vector<Face> screenFaces;
+		std::vector<PixelRect> screenBounds;
+		//With deferred shading the visibility buffer id of each face
+		std::vector<uint32_t> screenIds;
+		//Indices of the faces touching each band one band after another, band i's are from bandStarts[i] to bandStarts[i + 1]
+		std::vector<uint32_t> bandStarts;
+		std::vector<uint32_t> bandFaces;
+	};
+	static thread_local ModelScratch modelScratch;
+	//Triangles from the previous clip plane, used by ClipFace
+	static thread_local std::vector<Face> clipScratch;
+	//Only created when rasterizing with more than one thread
+	static thread_local std::unique_ptr<ThreadPool> rasterPool;
+
+	//Get the render pixels inside a rectangle in screen space rounded outwards, clamped to the window. Returns false if none are
+	static bool ScreenRect(double minX, double minY, double maxX, double maxY, Vector2Int renderSize, PixelRect& rect)
+	{
+		minX = std::floor(minX);
+		minY = std::floor(minY);
+		maxX = std::ceil(maxX);
+		maxY = std::ceil(maxY);
+		//Also false for NaN
+		if (!(maxX >= 0 && minX < renderSize.x && maxY >= 0 && minY < renderSize.y))
+			return false;
+
+		rect = { (int)std::max(minX, 0.0), (int)std::max(minY, 0.0), (int)std::min(maxX, renderSize.x - 1.0), (int)std::min(maxY, renderSize.y - 1.0) };
+		return true;
+	}
+
+	//Get the render pixels a face in screen space can cover, the rasterizers never draw outside its rounded vertices. Returns false if none are
+	static bool ScreenBounds(const Tri& verts, Vector2Int renderSize, PixelRect& bounds)
+	{
+		return ScreenRect(std::min({ verts.v0.x, verts.v1.x, verts.v2.x }), std::min({ verts.v0.y, verts.v1.y, verts.v2.y }),
+			std::max({ verts.v0.x, verts.v1.x, verts.v2.x }), std::max({ verts.v0.y, verts.v1.y, verts.v2.y }), renderSize, bounds);
+	}
+
+	//Is a model's bounding sphere hidden behind what the window has already drawn
+	static bool ModelOccluded(ModelInstance* model, Camera* cam, Window* window)
+	{
+		Sphere sphere = model->GetBoundingSphere();
+		Vector3 center = cam->GetView() * Vector4(sphere.center, 1);
+		//A little bigger since the radius is rounded to a float
+		double radius = sphere.radius * 1.001 + 0.001;
+		//The camera looks down -z, which is the depth faces are drawn with
+		double nearest = -center.z - radius;
+		if (nearest <= 0)
+			return false;
+
+		//The sphere is inside the box around it, whose screen bounds are those of its corners since they are all in front of the camera
+		Vector3 windowHalfSize(window->GetRenderSize() / 2, 1);
+		double minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+		for (int i = 0; i < 8; i++)
+		{
+			Vector3 corner = center + Vector3(i & 1 ? radius : -radius, i & 2 ? radius : -radius, i & 4 ? radius : -radius);
+			Vector4 projected = cam->GetProjection() * Vector4(corner, 1.0);
+			double x = projected.x / projected.w * windowHalfSize.x + windowHalfSize.x;
+			double y = projected.y / projected.w * windowHalfSize.y + windowHalfSize.y;
+			minX = std::min(minX, x);
+			minY = std::min(minY, y);
+			maxX = std::max(maxX, x);
+			maxY = std::max(maxY, y);
+		}
+
+		PixelRect bounds;
+		return ScreenRect(minX, minY, maxX, maxY, window->GetRenderSize(), bounds) && window->IsOccluded(bounds, nearest);
+	}
+
+	//Get the thread pool of this thread, started or resized if rasterThreads changed
+	static ThreadPool& RasterPool()
+	{
+		size_t numWorkers = std::max(rasterThreads, (uint16_t)1) - 1;
+		if (!rasterPool || rasterPool->GetThreadCount() != numWorkers + 1)
+			rasterPool = std::make_unique<ThreadPool>(numWorkers);
+		return *rasterPool;
+	}
+
+	//Sort faces in screen space into the bands of rows they touch and draw every band on the thread pool
+	//Each band draws its faces in submission order and only inside its own rows, so the pixels are the same as drawing them one by one
+	static void RasterizeBands(ModelScratch& scratch, const Material* mat, Window* window)
+	{
+		Vector2Int renderSize = window->GetRenderSize();
+		size_t numBands = (renderSize.y + bandHeight - 1) / bandHeight;
+		std::vector<uint32_t>& starts = scratch.bandStarts;
+		starts.assign(numBands + 1, 0);
+
+		//Count the faces in each band, then each band starts where the ones before it end
+		for (const PixelRect& bounds : scratch.screenBounds)
+		{
+			for (int band = bounds.minY / bandHeight; band <= bounds.maxY / bandHeight; band++)
+				starts[band + 1]++;
+		}
+		for (size_t i = 0; i < numBands; i++)
+			starts[i + 1] += starts[i];
+
+		//A face is in every band at most, sized from what screenFaces can hold so this only grows when it does
+		scratch.bandFaces.reserve(scratch.screenFaces.capacity() * numBands);
+		scratch.bandFaces.resize(starts[numBands]);
+		//Fill each band in submission order, moving its start to its end as it goes and back after
+		for (size_t i = 0; i < scratch.screenFaces.size(); i++)
+		{
+			const PixelRect& bounds = scratch.screenBounds[i];
+			for (int band = bounds.minY / bandHeight; band <= bounds.maxY / bandHeight; band++)
+				scratch.bandFaces[starts[band]++] = (uint32_t)i;
+		}
+		for (size_t i = numBands; i > 0; i--)
+			starts[i] = starts[i - 1];
+		starts[0] = 0;
+
+		//The job only captures one pointer, so it fits in the std::function without allocating
+		struct BandJob
+		{
+			ModelScratch* scratch;
+			const Material* mat;
+			Window* window;
+			Vector2Int renderSize;
+		} job{ &scratch, mat, window, renderSize };
+		RasterPool().ParallelFor(numBands, [&job](size_t band)
+			{
+				int top = (int)band * bandHeight;
+				PixelRect clip{ 0, top, (int)job.renderSize.x - 1, (int)std::min<int64_t>(top + bandHeight, job.renderSize.y) - 1 };
+				for (uint32_t i = job.scratch->bandStarts[band]; i < job.scratch->bandStarts[band + 1]; i++)
+				{
+					uint32_t face = job.scratch->bandFaces[i];
+					if (deferredShading)
+						RasterizeTriangleVisibility(job.window, job.scratch->screenFaces[face].vertices, job.scratch->screenIds[face], clip);
+					else
+						RasterizeTriangle(job.window, job.scratch->screenFaces[face], job.mat, clip);
+				}
+			});
+	}
+
 	//Render a point to the window's framebuffer
 	void DrawPoint(Vector3 point, Color color, Matrix4 transform, Camera* cam, Window* window)
 	{
@@ -62,12 +214,14 @@ namespace cvid
 		//Check if the model is inside, outside, or partially inside the clip space
 		std::bitset<8> clip = ClipModel(model, cam);
 
-		//Fully outside clip space
-		if (clip.none())
+		//Fully outside clip space, or hidden behind what is already drawn
+		if (clip.none() || ModelOccluded(model, cam, window))
 			return;
 
 		//Copy the vertices from the base model
-		std::vector<Vertex> vertices = model->GetBaseModel()->vertices;
+		ModelScratch& scratch = modelScratch;
+		std::vector<Vertex>& vertices = scratch.vertices;
+		vertices.assign(model->GetBaseModel()->vertices.begin(), model->GetBaseModel()->vertices.end());
 		const std::vector<Vector2>& texCoords = model->GetBaseModel()->texCoords;
 
 		//Apply model transform to all vertices
@@ -75,9 +229,11 @@ namespace cvid
 			vert.position = model->GetTransform() * Vector4(vert.position, 1.0);
 
 		//Recalculate normals, and cull backwards faces
-		std::vector<bool> culled;
+		std::vector<bool>& culled = scratch.culled;
+		culled.clear();
 		culled.reserve(model->GetBaseModel()->faces.size());
-		std::vector<Vector3> normals;
+		std::vector<Vector3>& normals = scratch.normals;
+		normals.clear();
 		normals.reserve(model->GetBaseModel()->faces.size());
 		for (const IndexedFace& face : model->GetBaseModel()->faces)
 		{
@@ -95,6 +251,24 @@ namespace cvid
 		//Apply view to all vertices
 		for (Vertex& vert : vertices)
 			vert.position = cam->GetView() * Vector4(vert.position, 1.0);
+
+		//With more threads the faces are collected and drawn once they are all in screen space
+		bool binned = rasterThreads > 1;
+		scratch.screenFaces.clear();
+		scratch.screenBounds.clear();
+		scratch.screenIds.clear();
+		//Room for every face unclipped, so a model turning to show more faces does not grow them
+		if (deferredShading)
+			window->ReserveVisibleFaces(model->GetBaseModel()->faces.size());
+		if (binned)
+		{
+			scratch.screenFaces.reserve(model->GetBaseModel()->faces.size());
+			scratch.screenBounds.reserve(model->GetBaseModel()->faces.size());
+			scratch.screenIds.reserve(model->GetBaseModel()->faces.size());
+		}
+		Vector2Int renderSize = window->GetRenderSize();
+		//Every pixel drawn faces can cover, for refreshing the window's occlusion culling after
+		PixelRect drawn{ INT_MAX, INT_MAX, INT_MIN, INT_MIN };
 		
 		//For each face in the model
 		for (size_t i = 0; i < model->GetBaseModel()->faces.size(); i++)
@@ -111,12 +285,15 @@ namespace cvid
 			};
 
 			//The final list of faces to render
-			std::vector<Face> faces{ face };
+			std::vector<Face>& faces = scratch.faces;
+			faces.reserve(maxClippedFaces);
 
 			//If model is partially intersecting at least one plane
 			if (clip.count() > 1)
 				//Clip the triangle against every intersecting plane
-				faces = ClipFace(face, cam, clip);
+				ClipFace(face, cam, clip, faces);
+			else
+				faces.assign(1, face);
 
 			//If the face was decomposed, loop over every new face, otherwise faces will only have one face
 			for (Face& face : faces)
@@ -140,7 +317,7 @@ namespace cvid
 				face.normal = normals[i];
 
 				//Convert from clip space to screen space
-				Vector3 windowHalfSize(window->GetSize() / 2, 1);
+				Vector3 windowHalfSize(window->GetRenderSize() / 2, 1);
 				face.vertices.v0 *= windowHalfSize;
 				face.vertices.v1 *= windowHalfSize;
 				face.vertices.v2 *= windowHalfSize;
@@ -151,13 +328,63 @@ namespace cvid
 				face.vertices.v1.z = v2.w;
 				face.vertices.v2.z = v3.w;
 
+				//Skip faces outside the window, or hidden behind what was drawn before this model
+				//The nearest vertex is moved a little nearer, interpolating depth across the face can overshoot it by rounding
+				PixelRect bounds;
+				if (!ScreenBounds(face.vertices, renderSize, bounds)
+					|| window->IsOccluded(bounds, std::min({ v1.w, v2.w, v3.w }) * (1 - 1e-9)))
+					continue;
+				drawn = { std::min(drawn.minX, bounds.minX), std::min(drawn.minY, bounds.minY), std::max(drawn.maxX, bounds.maxX), std::max(drawn.maxY, bounds.maxY) };
+
+				//Lit now, shaded once every model is drawn
+				uint32_t id = deferredShading ? window->AddVisibleFace(LightFace(face, model->GetMaterial())) : 0;
+
 				//Draw the face (triangle)
-				RasterizeTriangle(window, face, model->GetMaterial());
+				if (binned)
+				{
+					scratch.screenFaces.push_back(face);
+					scratch.screenBounds.push_back(bounds);
+					scratch.screenIds.push_back(id);
+				}
+				else if (deferredShading)
+				{
+					RasterizeTriangleVisibility(window, face.vertices, id, { 0, 0, (int)renderSize.x - 1, (int)renderSize.y - 1 });
+				}
+				else
+				{
+					RasterizeTriangle(window, face, model->GetMaterial());
+				}
 			}
 		}
+
+		if (binned)
+			RasterizeBands(scratch, model->GetMaterial(), window);
+		window->UpdateOcclusion(drawn);
 	}
 
 
+	//Shade every pixel the window's visibility buffer holds once, in bands of rows on the thread pool with more than one thread
+	void ShadeDeferred(Window* window)
+	{
+		Vector2Int renderSize = window->GetRenderSize();
+		if (rasterThreads > 1)
+		{
+			size_t numBands = (renderSize.y + bandHeight - 1) / bandHeight;
+			//Every thread sets up faces as it comes across them, so they all get room for as many as the window can hold first
+			size_t numFaces = window->GetVisibleFaces().capacity();
+			RasterPool().ForEachThread([numFaces]() { ReserveShadeVisibility(numFaces); });
+			RasterPool().ParallelFor(numBands, [window](size_t band)
+				{
+					ShadeVisibility(window, (int)band * bandHeight, (int)band * bandHeight + bandHeight - 1);
+				});
+		}
+		else
+		{
+			ShadeVisibility(window, 0, (int)renderSize.y - 1);
+		}
+		window->ClearVisibility();
+	}
+
 	//Returns 0 if a model falls entirely outside a camera's clip space, 1 if it's entirely inside, and >1 if it falls in between
 	//If >1 the intersected planes can be acquired by checking each bit corresponding to a plane: 1 = near, 2 = left, 3 = right, 4 = bottom, and 5 = top
 	std::bitset<8> ClipModel(ModelInstance* model, Camera* cam)
@@ -194,10 +421,20 @@ namespace cvid
 	//Returns a vector with 0, 1, or more triangles clipped against every specified plane
 	//Planes are determined by checking the corresponding bit: 1 = near, 2 = left, 3 = right, 4 = bottom, and 5 = top
 	std::vector<Face> ClipFace(const Face& face, Camera* cam, std::bitset<8> planes)
+	{
+		std::vector<Face> clippedTris;
+		ClipFace(face, cam, planes, clippedTris);
+		return clippedTris;
+	}
+
+	//Clip a triangle against every specified plane into clippedTris, replacing what it had
+	//Does not allocate once clippedTris is big enough, so the same vector can be reused every face
+	void ClipFace(const Face& face, Camera* cam, std::bitset<8> planes, std::vector<Face>& clippedTris)
 	{
 		const std::array<Vector3, 5>& clipPlanes = cam->GetClipPlanes();
-		std::vector<Face> tris;
-		std::vector<Face> clippedTris = { face };
+		std::vector<Face>& tris = clipScratch;
+		tris.reserve(maxClippedFaces);
+		clippedTris.assign(1, face);
 		//For each clip plane
 		for (size_t i = 0; i < clipPlanes.size(); i++)
 		{
@@ -205,7 +442,7 @@ namespace cvid
 			if (planes.test(i + 1))
 			{
 				//Set the tris from last plane to be clipped against this plane
-				tris = clippedTris;
+				tris.assign(clippedTris.begin(), clippedTris.end());
 				clippedTris.clear();
 
 				//For each triangle
@@ -320,8 +557,6 @@ namespace cvid
 				}
 			}
 		}
-
-		return clippedTris;
 	}
 
 	//Clips a line against every specified camera clip plane, if line is entirely outside, both points will be (0, 0, 0)
@@ -0,0 +1,204 @@
+#include <cvid/SharedFrameRing.h>
+#include <cvid/Helpers.h>
+#include <cstring>
+#include <stdexcept>
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace cvid
+{
+	//Marks memory as a ring, also changes if the layout changes
+	constexpr uint32_t ringMagic = 0x43564631;
+
+	//Round up to a multiple of 64 bytes so every slot starts on its own cache line
+	static inline size_t AlignToCacheLine(size_t size)
+	{
+		return (size + 63) & ~(size_t)63;
+	}
+
+	//Create a new shared ring with slots for frames of up to maxPixels character pixels
+	SharedFrameRing::SharedFrameRing(const std::string& name, size_t maxPixels, uint32_t slotCount)
+	{
+		this->name = name;
+		owner = true;
+
+		size_t slotStride = AlignToCacheLine(sizeof(Slot) + maxPixels * sizeof(CharPixel));
+		Map(AlignToCacheLine(sizeof(Header)) + slotStride * slotCount);
+
+		header->slotCount = slotCount;
+		header->slotPixels = maxPixels;
+		header->slotStride = slotStride;
+		header->written = 0;
+		header->released = 0;
+		for (uint32_t i = 0; i < slotCount; i++)
+			GetSlot(i + 1)->sequence = 0;
+		//The reader checks this last
+		std::atomic_thread_fence(std::memory_order_release);
+		header->magic = ringMagic;
+	}
+
+	//Open a ring created by another process
+	SharedFrameRing::SharedFrameRing(const std::string& name)
+	{
+		this->name = name;
+		Map(0);
+
+		if (header->magic != ringMagic)
+		{
+			LogError("CVid error in SharedFrameRing: " + name + " is not a frame ring");
+			throw std::runtime_error("Shared memory is not a frame ring");
+		}
+	}
+
+#ifdef _WIN32
+	//Map the shared memory, creating it if size is not 0
+	void SharedFrameRing::Map(size_t size)
+	{
+		if (owner)
+			mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, name.c_str());
+		else
+			mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+
+		if (mapping == NULL)
+		{
+			LogError("CVid error in SharedFrameRing: Failed to open shared memory, code " + std::to_string(GetLastError()));
+			throw std::runtime_error("Failed to open shared memory");
+		}
+
+		//Zero maps the whole thing
+		header = (Header*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+		if (header == nullptr)
+		{
+			LogError("CVid error in SharedFrameRing: Failed to map shared memory, code " + std::to_string(GetLastError()));
+			CloseHandle(mapping);
+			throw std::runtime_error("Failed to map shared memory");
+		}
+		mappingSize = size;
+	}
+
+	SharedFrameRing::~SharedFrameRing()
+	{
+		UnmapViewOfFile(header);
+		//Windows frees the memory once every handle is closed
+		CloseHandle(mapping);
+	}
+#else
+	//Map the shared memory, creating it if size is not 0
+	void SharedFrameRing::Map(size_t size)
+	{
+		if (owner)
+			fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		else
+			fd = shm_open(name.c_str(), O_RDWR, 0);
+
+		if (fd < 0)
+		{
+			LogError("CVid error in SharedFrameRing: Failed to open shared memory " + name + ", " + strerror(errno));
+			throw std::runtime_error("Failed to open shared memory");
+		}
+
+		//The creator sets the size, the opener finds it out
+		struct stat info;
+		if ((owner && ftruncate(fd, size) != 0) || (!owner && fstat(fd, &info) != 0))
+		{
+			LogError("CVid error in SharedFrameRing: Failed to size shared memory, " + std::string(strerror(errno)));
+			close(fd);
+			if (owner)
+				shm_unlink(name.c_str());
+			throw std::runtime_error("Failed to size shared memory");
+		}
+		if (!owner)
+			size = info.st_size;
+
+		void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (memory == MAP_FAILED)
+		{
+			LogError("CVid error in SharedFrameRing: Failed to map shared memory, " + std::string(strerror(errno)));
+			close(fd);
+			if (owner)
+				shm_unlink(name.c_str());
+			throw std::runtime_error("Failed to map shared memory");
+		}
+		header = (Header*)memory;
+		mappingSize = size;
+	}
+
+	SharedFrameRing::~SharedFrameRing()
+	{
+		munmap(header, mappingSize);
+		close(fd);
+		//The memory stays until the other process unmaps it too
+		if (owner)
+			shm_unlink(name.c_str());
+	}
+#endif
+
+	//Copy a frame into the next free slot, height is in characters
+	//Returns the frame's sequence number, or 0 if the frame is too big or the reader has not released any slot
+	uint64_t SharedFrameRing::Write(const CharPixel* frame, uint16_t width, uint16_t height)
+	{
+		size_t pixels = (size_t)width * height;
+		if (pixels > header->slotPixels)
+			return 0;
+
+		//Only the writer changes written, so no one else can take this sequence number
+		uint64_t sequence = header->written.load(std::memory_order_relaxed) + 1;
+		if (sequence - header->released.load(std::memory_order_acquire) > header->slotCount)
+			return 0;
+
+		Slot* slot = GetSlot(sequence);
+		memcpy((void*)(slot + 1), frame, pixels * sizeof(CharPixel));
+		slot->width = width;
+		slot->height = height;
+
+		//Publish the pixels before the sequence number
+		slot->sequence.store(sequence, std::memory_order_release);
+		header->written.store(sequence, std::memory_order_release);
+		return sequence;
+	}
+
+	//Get a frame by sequence number, height is in characters. Returns nullptr if the slot holds a different frame
+	const CharPixel* SharedFrameRing::Read(uint64_t sequence, uint16_t& width, uint16_t& height)
+	{
+		if (sequence == 0)
+			return nullptr;
+
+		Slot* slot = GetSlot(sequence);
+		if (slot->sequence.load(std::memory_order_acquire) != sequence)
+			return nullptr;
+
+		width = slot->width;
+		height = slot->height;
+		return (const CharPixel*)(slot + 1);
+	}
+
+	//Let the writer reuse the slots of every frame up to and including sequence
+	void SharedFrameRing::Release(uint64_t sequence)
+	{
+		header->released.store(sequence, std::memory_order_release);
+	}
+
+	//Get the name other processes open the ring by
+	const std::string& SharedFrameRing::GetName()
+	{
+		return name;
+	}
+
+	//Get the most character pixels a frame can have
+	size_t SharedFrameRing::GetMaxPixels()
+	{
+		return header->slotPixels;
+	}
+
+	//Get a slot by sequence number
+	SharedFrameRing::Slot* SharedFrameRing::GetSlot(uint64_t sequence)
+	{
+		char* slots = (char*)header + AlignToCacheLine(sizeof(Header));
+		return (Slot*)(slots + ((sequence - 1) % header->slotCount) * header->slotStride);
+	}
+}
\ No newline at end of file
@@ -26,11 +26,18 @@ namespace cvid
 
 		//Convert the pixel data to a more easily usable format
 		data.reserve((size_t)width * height);
+		uint64_t totalR = 0, totalG = 0, totalB = 0;
 		for (size_t i = 0; i < (size_t)width * height * 4; i += 4)
 		{
 			data.push_back(Color{ rawData[i], rawData[i + 1], rawData[i + 2], rawData[i + 3] });
+			totalR += rawData[i];
+			totalG += rawData[i + 1];
+			totalB += rawData[i + 2];
 		}
 
+		if (!data.empty())
+			averageColor = Color{ (uint8_t)(totalR / data.size()), (uint8_t)(totalG / data.size()), (uint8_t)(totalB / data.size()) };
+
 		//Delete the raw pixel data
 		stbi_image_free(rawData);
 	}
@@ -0,0 +1,119 @@
+#include <cvid/ThreadPool.h>
+
+namespace cvid
+{
+	//Create a pool with some amount of worker threads
+	ThreadPool::ThreadPool(size_t numWorkers)
+	{
+		workers.reserve(numWorkers);
+		for (size_t i = 0; i < numWorkers; i++)
+			workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		jobStarted.notify_all();
+
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+
+	//Run job(i) for every i in [0, count) on the workers and the calling thread, returns once all are done
+	void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& job)
+	{
+		//Not worth waking anyone up
+		if (workers.empty() || count <= 1)
+		{
+			for (size_t i = 0; i < count; i++)
+				job(i);
+			return;
+		}
+
+		//Help out instead of just waiting
+		RunOnWorkers(&job, count, nullptr, [this]() { WorkOnJob(); });
+	}
+
+	//Run job once on every worker and the calling thread, for setting up thread local state
+	void ThreadPool::ForEachThread(const std::function<void()>& job)
+	{
+		if (workers.empty())
+		{
+			job();
+			return;
+		}
+
+		RunOnWorkers(nullptr, 0, &job, job);
+	}
+
+	//Hand a job to every worker and wait until they are all done with it, the calling thread runs work in between
+	void ThreadPool::RunOnWorkers(const std::function<void(size_t)>* loopJob, size_t count, const std::function<void()>* threadJob, const std::function<void()>& work)
+	{
+		//Publish the job
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			this->job = loopJob;
+			this->threadJob = threadJob;
+			jobCount = count;
+			nextIndex = 0;
+			busyWorkers = workers.size();
+			jobGeneration++;
+		}
+		jobStarted.notify_all();
+
+		work();
+
+		//Wait for every worker to be done with it before the job goes out of scope
+		std::unique_lock<std::mutex> lock(mutex);
+		jobFinished.wait(lock, [&]() { return busyWorkers == 0; });
+		this->job = nullptr;
+		this->threadJob = nullptr;
+	}
+
+	//Get how many threads work on a job, including the calling thread
+	size_t ThreadPool::GetThreadCount()
+	{
+		return workers.size() + 1;
+	}
+
+	//Wait for jobs and work on them until the pool is destroyed
+	void ThreadPool::WorkerLoop()
+	{
+		uint64_t lastGeneration = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				jobStarted.wait(lock, [&]() { return stopping || jobGeneration != lastGeneration; });
+				if (stopping)
+					return;
+				lastGeneration = jobGeneration;
+			}
+
+			if (threadJob)
+				(*threadJob)();
+			else
+				WorkOnJob();
+
+			//Let ParallelFor know this worker is done
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--busyWorkers == 0)
+				jobFinished.notify_all();
+		}
+	}
+
+	//Take indices from the current job until there are none left
+	void ThreadPool::WorkOnJob()
+	{
+		while (true)
+		{
+			size_t i = nextIndex++;
+			if (i >= jobCount)
+				return;
+			(*job)(i);
+		}
+	}
+}
\ No newline at end of file
@@ -1,179 +1,102 @@
 #include <cvid/Window.h>
 #include <cvid/Helpers.h>
-#include <format>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <bit>
+
+#if defined(__AVX2__)
+#define CVID_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define CVID_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace cvid
 {
-	Vector2Int MaxWindowSize()
+	//Largest values of the fixed point depth formats
+	constexpr double fixed24Max = (1 << 24) - 1;
+	constexpr double fixed16Max = (1 << 16) - 1;
+
+	//Bytes each pixel of the depth buffer takes
+	static constexpr size_t DepthFormatSize(DepthFormat format)
+	{
+		switch (format)
+		{
+		case DepthFormat::Float64:
+			return sizeof(double);
+		case DepthFormat::Fixed16:
+			return sizeof(uint16_t);
+		default:
+			return sizeof(uint32_t);
+		}
+	}
+
+	//Fixed point inverse depth of a distance in front of the camera, maxValue at near and closer
+	static inline uint32_t FixedDepth(double z, double near, double maxValue)
 	{
-		HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
-		return Vector2Int(GetLargestConsoleWindowSize(console).X, GetLargestConsoleWindowSize(console).Y * 2);
-	};
+		double q = near / z;
+		//Same operands as _mm256_min_pd, so PutClippedSpan gets the same values four at a time
+		q = q < 1.0 ? q : 1.0;
+		return (uint32_t)(q * maxValue + 0.5);
+	}
+
+	//Smallest value of a w by h rectangle of a depth buffer
+	template<typename T>
+	static double SmallestDepth(const T* depth, size_t stride, int w, int h)
+	{
+		T smallest = depth[0];
+		for (int y = 0; y < h; y++)
+			for (int x = 0; x < w; x++)
+				smallest = std::min(smallest, depth[y * stride + x]);
+		return smallest;
+	}
 
 	//Create a new console window
 	Window::Window(uint16_t width, uint16_t height, std::string name, bool newProcess)
+		: Window(width, height, name, newProcess ? WindowMode::NewProcess : WindowMode::Main)
+	{
+	}
+
+	//Create a new window with dimensions in console pixels
+	Window::Window(uint16_t width, uint16_t height, std::string name, WindowMode mode)
 	{
 		//Round height to upper multiple of 2
 		height += height % 2;
 		//Setup some basic variables
 		this->width = width;
 		this->height = height;
+		UpdateRenderSize();
 		this->name = name;
-		this->seperateProcess = newProcess;
+		this->seperateProcess = mode == WindowMode::NewProcess;
+		this->headless = mode == WindowMode::Headless;
 		numWindowsCreated++;
 
 		//Create the frame and depth buffers
 		frameBuffer = new CharPixel[(size_t)width * height / 2];
-		depthBuffer = new double[(size_t)width * height];
+		depthBuffer = new uint8_t[(size_t)width * height * DepthFormatSize(depthFormat)];
 		ClearDepthBuffer();
 
 		//Create a new console window process if requested, otherwise usurp the main console
-		if (newProcess)
+		if (mode == WindowMode::NewProcess)
 			CreateAsNewProcess(name);
-		else
+		else if (mode == WindowMode::Main)
 			CreateAsMain(name);
 
 		//Set the properties of the Window
 		Resize(width, height);
 	}
 
-	//Create this window using the main application's console
-	void Window::CreateAsMain(std::string name)
-	{
-		//Get the console handle
-		consoleOut = GetStdHandle(STD_OUTPUT_HANDLE);
-		consoleIn = GetStdHandle(STD_INPUT_HANDLE);
-
-		//Save the original window stats
-		CONSOLE_SCREEN_BUFFER_INFO origInfo;
-		GetConsoleScreenBufferInfo(consoleOut, &origInfo);
-		originalSize = origInfo.srWindow;
-		originalSbSize = origInfo.dwSize;
-		GetConsoleTitle(originalTitle, sizeof(originalTitle));
-
-		//Enable virtual terminal processing
-		SetConsoleMode(consoleOut, ENABLE_VIRTUAL_TERMINAL_PROCESSING | ENABLE_PROCESSED_OUTPUT);
-		//Disable quick edit
-		originalMode = 0;
-		GetConsoleMode(consoleIn, &originalMode);
-		SetConsoleMode(consoleIn, (originalMode & ~ENABLE_QUICK_EDIT_MODE) | ENABLE_WINDOW_INPUT | ENABLE_MOUSE_INPUT);
-		//Rename window
-		SetConsoleTitle(name.c_str());
-
-		//Hide the cursor
-		std::cout << "\x1b[?25l";
-	}
-
-	//Create this window as a new process
-	void Window::CreateAsNewProcess(std::string name)
-	{
-		//Create the outbound pipe to the new console process
-		unsigned int pid = GetCurrentProcessId();
-		std::string genericPipeName = std::format("\\\\.\\pipe\\process{}window{}", pid, numWindowsCreated);
-		outPipeName = genericPipeName + "out";
-		outPipe = CreateNamedPipeA(
-			outPipeName.c_str(),
-			PIPE_ACCESS_OUTBOUND,
-			PIPE_TYPE_MESSAGE | PIPE_READMODE_BYTE | PIPE_NOWAIT,
-			1, //Max instances
-			16386, //Output buffer size 
-			0, //Input buffer size
-			1000, //Time out in ms
-			NULL //Security attributes
-		);
-		//Make sure the pipe creation worked
-		if (outPipe == NULL || outPipe == INVALID_HANDLE_VALUE)
-		{
-			LogError("CVid error in Window: Failed to create pipe, code " + std::to_string(GetLastError()));
-			throw std::runtime_error("Failed to create pipe");
-			return;
-		}
-
-		//Create the inbound pipe from the new console process
-		inPipeName = genericPipeName + "in";
-		inPipe = CreateNamedPipeA(
-			inPipeName.c_str(),
-			PIPE_ACCESS_INBOUND,
-			PIPE_TYPE_MESSAGE | PIPE_READMODE_BYTE | PIPE_WAIT,
-			1, //Max instances
-			0, //Output buffer size 
-			8, //Input buffer size
-			50, //Time out in ms
-			NULL //Security attributes
-		);
-		//Make sure the pipe creation worked
-		if (inPipe == NULL || inPipe == INVALID_HANDLE_VALUE)
-		{
-			LogError("CVid error in Window: Failed to create pipe, code " + std::to_string(GetLastError()));
-			throw std::runtime_error("Failed to create pipe");
-			return;
-		}
-
-		//Create an instance of the ConsoleWindowApp
-		//Setup startup info
-		STARTUPINFO startupInfo;
-		ZeroMemory(&startupInfo, sizeof(startupInfo));
-		ZeroMemory(&processInfo, sizeof(processInfo));
-		startupInfo.cb = sizeof(startupInfo);
-		startupInfo.lpTitle = name.data();
-
-		//Create the process
-		std::string cmdline("ConsoleWindowApp.exe ");
-		cmdline.append(genericPipeName);
-		bool createProcessSuccess = CreateProcessA(
-			NULL, //App name, default to cmd
-			cmdline.data(), //Comand line, send the pipe name
-			NULL, NULL, //Security attributes
-			false, //Inherit handles
-			NORMAL_PRIORITY_CLASS | CREATE_NEW_CONSOLE | CREATE_NEW_PROCESS_GROUP, //Creation flags
-			NULL, NULL, //Irrelevant
-			&startupInfo,
-			&processInfo
-		);
-		//Make sure the process creation worked
-		if (!createProcessSuccess)
-		{
-			LogError("CVid error in Window: Failed to create window process, code " + std::to_string(GetLastError()));
-			throw std::runtime_error("Failed to create process");
-			return;
-		}
-
-		//Connect the pipes
-		bool connectPipeSuccess = ConnectNamedPipe(inPipe, NULL);
-		if (!connectPipeSuccess)
-		{
-			//Some other error
-			LogError("CVid error in Window: Failed to connect pipe, code " + std::to_string(GetLastError()));
-			CloseHandle(inPipe);
-			throw std::runtime_error("Failed to connect pipe");
-			return;
-		}
-
-		connectPipeSuccess = ConnectNamedPipe(outPipe, NULL);
-		//Make sure the pipe connected successfully
-		while (!connectPipeSuccess)
-		{
-			//Wait for process to connect
-			if (GetLastError() == ERROR_PIPE_LISTENING)
-			{
-				connectPipeSuccess = ConnectNamedPipe(outPipe, NULL);
-				continue;
-			}
-
-			if (GetLastError() == ERROR_PIPE_CONNECTED)
-				break;
-
-			//Some other error
-			LogError("CVid error in Window: Failed to connect pipe, code " + std::to_string(GetLastError()));
-			CloseHandle(outPipe);
-			throw std::runtime_error("Failed to connect pipe");
-			return;
-		}
-	}
-
 	Window::~Window()
 	{
+		StopPresentThread();
 		CloseWindow();
+
+		delete[] frameBuffer;
+		delete[] depthBuffer;
 	}
 
 	//Set a pixel on the framebuffer to some color, returns true on success
@@ -185,20 +108,13 @@ namespace cvid
 	bool Window::PutPixel(uint16_t x, uint16_t y, Color color)
 	{
 		//Make sure the pixel is in bounds
-		if (x >= width || y >= height)
+		if (x >= renderWidth || y >= renderHeight)
 			return false;
 
-		//Pixels are formatted two above each other in one character
-		//We will always print 223 where foreground is the top and background is the bottom.
-		CharPixel& thisPixel = frameBuffer[((height - 1 - y) / 2) * width + x];
-
-		//Set the pixel character
-		thisPixel.character = (char)223;
-		//Top or bottom pixel
-		if (y % 2 == 0)
-			thisPixel.bg = color;
+		if (renderScale == 1)
+			SetConsolePixel(x, y, color);
 		else
-			thisPixel.fg = color;
+			SetRenderPixel(x, y, color);
 
 		return true;
 	}
@@ -211,18 +127,287 @@ namespace cvid
 	bool Window::PutPixel(uint16_t x, uint16_t y, Color color, double z)
 	{
 		//Make sure the pixel is in bounds
-		if (x >= width || y >= height || z < 0)
+		if (x >= renderWidth || y >= renderHeight || z < 0)
 			return false;
 
 		//Make sure there is not already a closer pixel
-		if (enableDepthTest)
+		if (enableDepthTest && !TestDepth((size_t)y * width + x, z))
+			return false;
+
+		if (renderScale == 1)
+			SetConsolePixel(x, y, color);
+		else
+			SetRenderPixel(x, y, color);
+
+		return true;
+	}
+
+	//Set a row of count pixels starting at x, y to colors, implements depth buffer like PutPixel, returns how many were set
+	//Picks the variant of PutClippedSpan compiled for the depth test, depth format, and render scale once per span
+	int Window::PutSpan(int x, int y, int count, const Color* colors, const double* depths)
+	{
+		//Clip the span to the window
+		if (y < 0 || y >= renderHeight)
+			return 0;
+		if (x < 0)
+		{
+			colors -= x;
+			depths -= x;
+			count += x;
+			x = 0;
+		}
+		count = std::min(count, renderWidth - x);
+		if (count <= 0)
+			return 0;
+
+		//Indexed [depth test][depth format][render scale above 1], without the depth test the format does not matter
+		using PutSpanFunction = int (Window::*)(int, int, int, const Color*, const double*);
+		static constexpr PutSpanFunction variants[2][4][2] = {
+			{
+				{ &Window::PutClippedSpan<false, DepthFormat::Float64, false>, &Window::PutClippedSpan<false, DepthFormat::Float64, true> },
+				{ &Window::PutClippedSpan<false, DepthFormat::Float64, false>, &Window::PutClippedSpan<false, DepthFormat::Float64, true> },
+				{ &Window::PutClippedSpan<false, DepthFormat::Float64, false>, &Window::PutClippedSpan<false, DepthFormat::Float64, true> },
+				{ &Window::PutClippedSpan<false, DepthFormat::Float64, false>, &Window::PutClippedSpan<false, DepthFormat::Float64, true> }
+			},
+			{
+				{ &Window::PutClippedSpan<true, DepthFormat::Float64, false>, &Window::PutClippedSpan<true, DepthFormat::Float64, true> },
+				{ &Window::PutClippedSpan<true, DepthFormat::Float32Reversed, false>, &Window::PutClippedSpan<true, DepthFormat::Float32Reversed, true> },
+				{ &Window::PutClippedSpan<true, DepthFormat::Fixed24, false>, &Window::PutClippedSpan<true, DepthFormat::Fixed24, true> },
+				{ &Window::PutClippedSpan<true, DepthFormat::Fixed16, false>, &Window::PutClippedSpan<true, DepthFormat::Fixed16, true> }
+			}
+		};
+		return (this->*variants[enableDepthTest][(size_t)depthFormat][renderScale != 1])(x, y, count, colors, depths);
+	}
+
+	//Set a row of pixels inside the window, compiled for one depth test setting, depth format, and render scale so the loops do not branch on them
+	//The depth test is done several pixels at a time where supported
+	template<bool depthTest, DepthFormat format, bool scaled>
+	int Window::PutClippedSpan(int x, int y, int count, const Color* colors, const double* depths)
+	{
+		size_t rowStart = (size_t)y * width + x;
+		int set = 0;
+		int i = 0;
+#if defined(CVID_AVX2)
+		if constexpr (!depthTest || format == DepthFormat::Float64)
+		{
+			double* depthRow = (double*)depthBuffer + rowStart;
+			for (; i + 4 <= count; i += 4)
+			{
+				__m256d depth = _mm256_loadu_pd(depths + i);
+				//Same comparisons as PutPixel, so NaN depths are drawn there and here
+				__m256d rejected = _mm256_cmp_pd(depth, _mm256_setzero_pd(), _CMP_LT_OQ);
+				if constexpr (depthTest)
+				{
+					__m256d stored = _mm256_loadu_pd(depthRow + i);
+					rejected = _mm256_or_pd(rejected, _mm256_cmp_pd(_mm256_sub_pd(depth, stored), _mm256_set1_pd(0.5), _CMP_GT_OQ));
+					_mm256_storeu_pd(depthRow + i, _mm256_blendv_pd(depth, stored, rejected));
+				}
+
+				for (unsigned mask = ~_mm256_movemask_pd(rejected) & 0xf; mask; mask &= mask - 1)
+				{
+					int lane = i + std::countr_zero(mask);
+					SetSpanPixel<scaled>(x + lane, y, colors[lane]);
+					set++;
+				}
+			}
+		}
+		else
+		{
+			//The reversed formats, the same operations as TestDepth on four pixels
+			constexpr size_t depthSize = DepthFormatSize(format);
+			for (; i + 4 <= count; i += 4)
+			{
+				__m256d depth = _mm256_loadu_pd(depths + i);
+				//Pixels at or behind the camera, and NaN, are never drawn
+				unsigned rejected = _mm256_movemask_pd(_mm256_cmp_pd(depth, _mm256_setzero_pd(), _CMP_NGT_UQ));
+				__m128i values;
+				if constexpr (format == DepthFormat::Float32Reversed)
+				{
+					__m128 inverse = _mm256_cvtpd_ps(_mm256_div_pd(_mm256_set1_pd(1.0), depth));
+					__m128 stored = _mm_loadu_ps((const float*)depthBuffer + rowStart + i);
+					rejected |= ~_mm_movemask_ps(_mm_cmpge_ps(inverse, stored)) & 0xf;
+					values = _mm_castps_si128(inverse);
+				}
+				else
+				{
+					constexpr bool fixed16 = format == DepthFormat::Fixed16;
+					__m256d q = _mm256_min_pd(_mm256_div_pd(_mm256_set1_pd(fixedDepthNear), depth), _mm256_set1_pd(1.0));
+					values = _mm256_cvttpd_epi32(_mm256_add_pd(_mm256_mul_pd(q, _mm256_set1_pd(fixed16 ? fixed16Max : fixed24Max)), _mm256_set1_pd(0.5)));
+					__m128i stored = fixed16 ? _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)((const uint16_t*)depthBuffer + rowStart + i)))
+						: _mm_loadu_si128((const __m128i*)((const uint32_t*)depthBuffer + rowStart + i));
+					//Both are below 2^24 in the lanes which are in front of the camera, so a signed compare works
+					rejected |= _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(stored, values)));
+				}
+
+				uint32_t laneValues[4];
+				_mm_storeu_si128((__m128i*)laneValues, values);
+				for (unsigned mask = ~rejected & 0xf; mask; mask &= mask - 1)
+				{
+					int lane = i + std::countr_zero(mask);
+					//Fixed16 values fit in the low half, which comes first
+					memcpy(depthBuffer + (rowStart + lane) * depthSize, &laneValues[lane - i], depthSize);
+					SetSpanPixel<scaled>(x + lane, y, colors[lane]);
+					set++;
+				}
+			}
+		}
+#elif defined(CVID_SSE2)
+		if constexpr (!depthTest || format == DepthFormat::Float64)
+		{
+			double* depthRow = (double*)depthBuffer + rowStart;
+			for (; i + 2 <= count; i += 2)
+			{
+				__m128d depth = _mm_loadu_pd(depths + i);
+				//Same comparisons as PutPixel, so NaN depths are drawn there and here
+				__m128d rejected = _mm_cmplt_pd(depth, _mm_setzero_pd());
+				if constexpr (depthTest)
+				{
+					__m128d stored = _mm_loadu_pd(depthRow + i);
+					rejected = _mm_or_pd(rejected, _mm_cmpgt_pd(_mm_sub_pd(depth, stored), _mm_set1_pd(0.5)));
+					_mm_storeu_pd(depthRow + i, _mm_or_pd(_mm_and_pd(rejected, stored), _mm_andnot_pd(rejected, depth)));
+				}
+
+				for (unsigned mask = ~_mm_movemask_pd(rejected) & 0x3; mask; mask &= mask - 1)
+				{
+					int lane = i + std::countr_zero(mask);
+					SetSpanPixel<scaled>(x + lane, y, colors[lane]);
+					set++;
+				}
+			}
+		}
+#endif
+		//The rest one at a time
+		for (; i < count; i++)
+		{
+			if (depths[i] < 0)
+				continue;
+			if constexpr (depthTest)
+			{
+				if (!TestDepth<format>(rowStart + i, depths[i]))
+					continue;
+			}
+
+			SetSpanPixel<scaled>(x + i, y, colors[i]);
+			set++;
+		}
+		return set;
+	}
+
+	//Store id in the visibility buffer for a row of pixels instead of colors, with the same depth test as PutSpan
+	int Window::PutVisibilitySpan(int x, int y, int count, uint32_t id, const double* depths)
+	{
+		//Clip the span to the window
+		if (y < 0 || y >= renderHeight)
+			return 0;
+		if (x < 0)
+		{
+			depths -= x;
+			count += x;
+			x = 0;
+		}
+		count = std::min(count, renderWidth - x);
+		if (count <= 0)
+			return 0;
+
+		//Allocated before drawing on several threads by AddVisibleFace
+		if (visibilityBuffer.empty())
+			visibilityBuffer.assign((size_t)renderWidth * renderHeight, 0);
+
+		size_t rowStart = (size_t)y * width + x;
+		uint32_t* ids = visibilityBuffer.data() + (size_t)y * renderWidth + x;
+		int set = 0;
+		for (int i = 0; i < count; i++)
+		{
+			if (depths[i] < 0)
+				continue;
+			if (enableDepthTest && !TestDepth(rowStart + i, depths[i]))
+				continue;
+
+			ids[i] = id;
+			set++;
+		}
+		return set;
+	}
+
+	//Test a depth against the depth buffer at an index and store it if it is in front, the depth test must be enabled
+	bool Window::TestDepth(size_t index, double z)
+	{
+		switch (depthFormat)
+		{
+		case DepthFormat::Float64:
+			return TestDepth<DepthFormat::Float64>(index, z);
+		case DepthFormat::Float32Reversed:
+			return TestDepth<DepthFormat::Float32Reversed>(index, z);
+		case DepthFormat::Fixed24:
+			return TestDepth<DepthFormat::Fixed24>(index, z);
+		case DepthFormat::Fixed16:
+			return TestDepth<DepthFormat::Fixed16>(index, z);
+		}
+		return false;
+	}
+
+	//Test a depth against the depth buffer at an index in a known format and store it if it is in front
+	template<DepthFormat format>
+	inline bool Window::TestDepth(size_t index, double z)
+	{
+		if constexpr (format == DepthFormat::Float64)
 		{
+			double& stored = ((double*)depthBuffer)[index];
 			//Basically smaller z means further away
-			if (z - depthBuffer[y * width + x] > 0.5)
+			if (z - stored > 0.5)
+				return false;
+			stored = z;
+			return true;
+		}
+		else if constexpr (format == DepthFormat::Float32Reversed)
+		{
+			//Pixels at or behind the camera, and NaN, are never drawn
+			if (!(z > 0))
+				return false;
+			float inverse = (float)(1.0 / z);
+			float& stored = ((float*)depthBuffer)[index];
+			if (inverse < stored)
+				return false;
+			stored = inverse;
+			return true;
+		}
+		else if constexpr (format == DepthFormat::Fixed24)
+		{
+			if (!(z > 0))
 				return false;
-			depthBuffer[y * width + x] = z;
+			uint32_t value = FixedDepth(z, fixedDepthNear, fixed24Max);
+			uint32_t& stored = ((uint32_t*)depthBuffer)[index];
+			if (value < stored)
+				return false;
+			stored = value;
+			return true;
+		}
+		else
+		{
+			if (!(z > 0))
+				return false;
+			uint16_t value = FixedDepth(z, fixedDepthNear, fixed16Max);
+			uint16_t& stored = ((uint16_t*)depthBuffer)[index];
+			if (value < stored)
+				return false;
+			stored = value;
+			return true;
 		}
+	}
 
+	//Set the console pixel or block of them a render pixel covers, scaled is whether the render scale is above 1
+	template<bool scaled>
+	inline void Window::SetSpanPixel(uint16_t x, uint16_t y, Color color)
+	{
+		if constexpr (scaled)
+			SetRenderPixel(x, y, color);
+		else
+			SetConsolePixel(x, y, color);
+	}
+
+	//Set a pixel of the framebuffer in console pixels, must be in bounds
+	inline void Window::SetConsolePixel(uint16_t x, uint16_t y, Color color)
+	{
 		//Pixels are formatted two above each other in one character
 		//We will always print 223 where foreground is the top and background is the bottom.
 		CharPixel& thisPixel = frameBuffer[((height - 1 - y) / 2) * width + x];
@@ -234,8 +419,17 @@ namespace cvid
 			thisPixel.bg = color;
 		else
 			thisPixel.fg = color;
+	}
 
-		return true;
+	//Set the block of console pixels covered by a render pixel, must be in bounds
+	void Window::SetRenderPixel(uint16_t x, uint16_t y, Color color)
+	{
+		//The last row and column of blocks can hang over the edge
+		uint16_t endX = std::min(width, (uint16_t)((x + 1) * renderScale));
+		uint16_t endY = std::min(height, (uint16_t)((y + 1) * renderScale));
+		for (uint16_t consoleY = y * renderScale; consoleY < endY; consoleY++)
+			for (uint16_t consoleX = x * renderScale; consoleX < endX; consoleX++)
+				SetConsolePixel(consoleX, consoleY, color);
 	}
 
 	//Set a character on the framebuffer, y is half of resolution
@@ -290,35 +484,233 @@ namespace cvid
 		return true;
 	}
 
-	//Clear the depthbuffer, setting everything to -1
+	//Clear the depth buffer so nothing is in front of any pixel
 	bool Window::ClearDepthBuffer()
 	{
-		for (size_t y = 0; y < height; y++)
+		//Only the rows render pixels use, they are one block of memory
+		size_t count = (size_t)renderHeight * width;
+		if (depthFormat == DepthFormat::Float64)
+			std::fill_n((double*)depthBuffer, count, INFINITY);
+		else
+			//The reversed formats are 0 infinitely far away
+			memset(depthBuffer, 0, count * DepthFormatSize(depthFormat));
+
+		//Nothing drawn hides nothing
+		occlusionTilesX = (renderWidth + occlusionTileSize - 1) / occlusionTileSize;
+		occlusionBlocksX = (occlusionTilesX + occlusionBlockSize - 1) / occlusionBlockSize;
+		int tilesY = (renderHeight + occlusionTileSize - 1) / occlusionTileSize;
+		int blocksY = (tilesY + occlusionBlockSize - 1) / occlusionBlockSize;
+		occlusionTiles.assign((size_t)occlusionTilesX * tilesY, 0);
+		occlusionBlocks.assign((size_t)occlusionBlocksX * blocksY, 0);
+
+		ClearVisibility();
+		return true;
+	}
+
+	//Add a face to shade the pixels of later, returns the id to put in the visibility buffer for it
+	//Also allocates the visibility buffer, so drawing into it on several threads never does
+	uint32_t Window::AddVisibleFace(const VisibleFace& face)
+	{
+		if (visibilityBuffer.empty())
+			visibilityBuffer.assign((size_t)renderWidth * renderHeight, 0);
+		visibleFaces.push_back(face);
+		return (uint32_t)visibleFaces.size();
+	}
+
+	//Make room for some more faces to be added
+	void Window::ReserveVisibleFaces(size_t count)
+	{
+		visibleFaces.reserve(visibleFaces.size() + count);
+	}
+
+	//Get the faces added since the visibility buffer was last cleared
+	const std::vector<VisibleFace>& Window::GetVisibleFaces()
+	{
+		return visibleFaces;
+	}
+
+	//Get a row of render pixels of the visibility buffer, null if nothing has been put in it
+	const uint32_t* Window::GetVisibilityRow(uint16_t y)
+	{
+		if (visibilityBuffer.empty() || y >= renderHeight)
+			return nullptr;
+		return visibilityBuffer.data() + (size_t)y * renderWidth;
+	}
+
+	//Forget the faces and the visibility buffer, it keeps its memory and is sized again when next used
+	void Window::ClearVisibility()
+	{
+		visibleFaces.clear();
+		if (!visibilityBuffer.empty())
+			visibilityBuffer.assign((size_t)renderWidth * renderHeight, 0);
+	}
+
+	//Would anything in a rectangle of render pixels no nearer than nearest fail the depth test everywhere
+	bool Window::IsOccluded(PixelRect rect, double nearest)
+	{
+		if (!enableOcclusionCulling || depthFormat == DepthFormat::Float64 || !enableDepthTest || !(nearest > 0))
+			return false;
+
+		//Only the part inside the window
+		rect.minX = std::max(rect.minX, 0);
+		rect.minY = std::max(rect.minY, 0);
+		rect.maxX = std::min(rect.maxX, renderWidth - 1);
+		rect.maxY = std::min(rect.maxY, renderHeight - 1);
+		if (rect.minX > rect.maxX || rect.minY > rect.maxY)
+			return false;
+
+		//Anything no nearer has at most this inverse depth, which fails where the smallest stored one is bigger
+		double depth = ReversedDepth(nearest);
+		int tileMinX = rect.minX / occlusionTileSize;
+		int tileMinY = rect.minY / occlusionTileSize;
+		int tileMaxX = rect.maxX / occlusionTileSize;
+		int tileMaxY = rect.maxY / occlusionTileSize;
+		for (int blockY = tileMinY / occlusionBlockSize; blockY <= tileMaxY / occlusionBlockSize; blockY++)
 		{
-			for (size_t x = 0; x < width; x++)
+			for (int blockX = tileMinX / occlusionBlockSize; blockX <= tileMaxX / occlusionBlockSize; blockX++)
 			{
-				depthBuffer[y * width + x] = INFINITY;
+				if (depth < occlusionBlocks[blockY * occlusionBlocksX + blockX])
+					continue;
+
+				//Not hidden in the whole block, check its tiles which are in the rectangle
+				int endY = std::min(tileMaxY, blockY * occlusionBlockSize + occlusionBlockSize - 1);
+				int endX = std::min(tileMaxX, blockX * occlusionBlockSize + occlusionBlockSize - 1);
+				for (int tileY = std::max(tileMinY, blockY * occlusionBlockSize); tileY <= endY; tileY++)
+					for (int tileX = std::max(tileMinX, blockX * occlusionBlockSize); tileX <= endX; tileX++)
+						if (!(depth < occlusionTiles[tileY * occlusionTilesX + tileX]))
+							return false;
 			}
 		}
 		return true;
 	}
 
-	//Get a pointer to the depth buffer bit of a pixel, returns nullptr on failure
+	//Refresh the depths occlusion culling tests against for a rectangle of render pixels
+	void Window::UpdateOcclusion(PixelRect rect)
+	{
+		if (!enableOcclusionCulling || depthFormat == DepthFormat::Float64)
+			return;
+
+		//Only the part inside the window
+		rect.minX = std::max(rect.minX, 0);
+		rect.minY = std::max(rect.minY, 0);
+		rect.maxX = std::min(rect.maxX, renderWidth - 1);
+		rect.maxY = std::min(rect.maxY, renderHeight - 1);
+		if (rect.minX > rect.maxX || rect.minY > rect.maxY)
+			return;
+
+		//Every tile touching the rectangle
+		int tileMinX = rect.minX / occlusionTileSize;
+		int tileMinY = rect.minY / occlusionTileSize;
+		int tileMaxX = rect.maxX / occlusionTileSize;
+		int tileMaxY = rect.maxY / occlusionTileSize;
+		for (int tileY = tileMinY; tileY <= tileMaxY; tileY++)
+		{
+			for (int tileX = tileMinX; tileX <= tileMaxX; tileX++)
+			{
+				//Tiles on the right and top edges can be cut off
+				int x = tileX * occlusionTileSize;
+				int y = tileY * occlusionTileSize;
+				int w = std::min(occlusionTileSize, renderWidth - x);
+				int h = std::min(occlusionTileSize, renderHeight - y);
+				size_t index = (size_t)y * width + x;
+
+				double& tile = occlusionTiles[tileY * occlusionTilesX + tileX];
+				if (depthFormat == DepthFormat::Float32Reversed)
+					tile = SmallestDepth((const float*)depthBuffer + index, width, w, h);
+				else if (depthFormat == DepthFormat::Fixed24)
+					tile = SmallestDepth((const uint32_t*)depthBuffer + index, width, w, h);
+				else
+					tile = SmallestDepth((const uint16_t*)depthBuffer + index, width, w, h);
+			}
+		}
+
+		//Every block of those tiles
+		int tilesY = (int)occlusionTiles.size() / occlusionTilesX;
+		for (int blockY = tileMinY / occlusionBlockSize; blockY <= tileMaxY / occlusionBlockSize; blockY++)
+		{
+			for (int blockX = tileMinX / occlusionBlockSize; blockX <= tileMaxX / occlusionBlockSize; blockX++)
+			{
+				double smallest = INFINITY;
+				int endY = std::min(tilesY, (blockY + 1) * occlusionBlockSize);
+				int endX = std::min(occlusionTilesX, (blockX + 1) * occlusionBlockSize);
+				for (int tileY = blockY * occlusionBlockSize; tileY < endY; tileY++)
+					for (int tileX = blockX * occlusionBlockSize; tileX < endX; tileX++)
+						smallest = std::min(smallest, occlusionTiles[tileY * occlusionTilesX + tileX]);
+				occlusionBlocks[blockY * occlusionBlocksX + blockX] = smallest;
+			}
+		}
+	}
+
+	//Inverse depth of a distance as a reversed depth format stores it
+	double Window::ReversedDepth(double z)
+	{
+		if (depthFormat == DepthFormat::Float32Reversed)
+			return (float)(1.0 / z);
+		return FixedDepth(z, fixedDepthNear, depthFormat == DepthFormat::Fixed16 ? fixed16Max : fixed24Max);
+	}
+
+	//Get a pointer to the depth buffer bit of a pixel in render coordinates, returns nullptr on failure or if the format is not Float64
 	double* Window::GetDepthBufferBit(uint16_t x, uint16_t y)
 	{
 		//Make sure the pixel is in bounds
-		if (x >= width || y >= height)
+		if (x >= renderWidth || y >= renderHeight || depthFormat != DepthFormat::Float64)
 			return nullptr;
 
-		return &depthBuffer[y * width + x];
+		return (double*)depthBuffer + (size_t)y * width + x;
+	}
+
+	//Get the distance stored in the depth buffer for a pixel in render coordinates, infinity if nothing has been drawn there
+	double Window::GetDepth(uint16_t x, uint16_t y)
+	{
+		//Make sure the pixel is in bounds
+		if (x >= renderWidth || y >= renderHeight)
+			return INFINITY;
+
+		size_t index = (size_t)y * width + x;
+		switch (depthFormat)
+		{
+		case DepthFormat::Float64:
+			return ((double*)depthBuffer)[index];
+		case DepthFormat::Float32Reversed:
+			return 1.0 / ((float*)depthBuffer)[index];
+		case DepthFormat::Fixed24:
+			return fixedDepthNear * fixed24Max / ((uint32_t*)depthBuffer)[index];
+		case DepthFormat::Fixed16:
+			return fixedDepthNear * fixed16Max / ((uint16_t*)depthBuffer)[index];
+		}
+		return INFINITY;
+	}
+
+	//Set how the depth buffer stores depth, clears the depth buffer
+	void Window::SetDepthFormat(DepthFormat format)
+	{
+		if (format != depthFormat)
+		{
+			delete[] depthBuffer;
+			depthBuffer = new uint8_t[(size_t)width * height * DepthFormatSize(format)];
+			depthFormat = format;
+		}
+		ClearDepthBuffer();
+	}
+
+	//Get how the depth buffer stores depth
+	DepthFormat Window::GetDepthFormat()
+	{
+		return depthFormat;
 	}
 
 	//Set the properties of this window, clears the framebuffer
 	bool Window::Resize(int16_t w, int16_t h)
 	{
-		//Make sure the window is not sized too big
+		//Make sure the window is not sized too big, headless windows can be any size
+		//On POSIX the window process has its own terminal which is not known here
+#ifdef _WIN32
+		bool sizeLimited = !headless;
+#else
+		bool sizeLimited = !headless && !seperateProcess;
+#endif
 		Vector2Int maxSize = MaxWindowSize();
-		if (w > maxSize.x || h > maxSize.y)
+		if (sizeLimited && (w > maxSize.x || h > maxSize.y))
 		{
 			LogWarning("CVid warning in Window: Window dimensions too large, maximum is " + std::to_string(maxWidth) + ", " + std::to_string(maxHeight));
 			return false;
@@ -328,6 +720,26 @@ namespace cvid
 		h += h % 2;
 		width = w;
 		height = h;
+		UpdateRenderSize();
+
+		//Frames waiting to be presented are the wrong size now
+		//One already taken off the queue is let finish, so it is not sent after the new size and read as one
+		{
+			std::unique_lock<std::mutex> lock(presentMutex);
+			while (!presentQueue.empty())
+			{
+				freeFrames.push_back(std::move(presentQueue.front()));
+				presentQueue.pop_front();
+			}
+			presentCondition.wait(lock, [&]() { return !presenting; });
+		}
+		presentCondition.notify_all();
+
+		//Resizing the console mangles its contents
+		{
+			std::lock_guard<std::mutex> lock(outputMutex);
+			encoder.Invalidate();
+		}
 
 		//Send it to the console app
 		if (seperateProcess)
@@ -336,7 +748,7 @@ namespace cvid
 			if (!SendData(&properties, sizeof(properties), DataType::Properties))
 				return false;
 		}
-		else
+		else if (!headless)
 		{
 			//Apply them straight to the main process console
 			ResizeMain(width, height);
@@ -346,156 +758,382 @@ namespace cvid
 		delete[] frameBuffer;
 		delete[] depthBuffer;
 		frameBuffer = new CharPixel[width * height / 2];
-		depthBuffer = new double[width * height];
+		depthBuffer = new uint8_t[(size_t)width * height * DepthFormatSize(depthFormat)];
+		ClearDepthBuffer();
 
 		return true;
 	}
 
-	//Resize the console to fit the frame
-	void Window::ResizeMain(int16_t w, int16_t h)
+	//Set how many console pixels wide and tall each pixel drawn with PutPixel is
+	void Window::SetRenderScale(uint16_t scale)
+	{
+		renderScale = std::max(scale, (uint16_t)1);
+		UpdateRenderSize();
+		//Only the rows in use are cleared, there may be more now
+		ClearDepthBuffer();
+	}
+
+	//Get how many console pixels wide and tall each pixel drawn with PutPixel is
+	uint16_t Window::GetRenderScale()
+	{
+		return renderScale;
+	}
+
+	//Get the size PutPixel and the depth buffer work in, the window size divided by the render scale
+	Vector2Int Window::GetRenderSize()
+	{
+		return Vector2Int(renderWidth, renderHeight);
+	}
+
+	//Recalculate the render size after the window size or render scale changed
+	void Window::UpdateRenderSize()
 	{
-		SMALL_RECT minSize{ 0, 0, 1, 1 };
-		SMALL_RECT consoleSize{ 0, 0, w - 1, (short)ceil((float)h / 2) - 1 };
-		COORD sbSize{ w, (short)ceil((float)h / 2) };
+		//Round up so the render pixels cover the whole window
+		renderWidth = (width + renderScale - 1) / renderScale;
+		renderHeight = (height + renderScale - 1) / renderScale;
+	}
 
-		//SetConsoleWindowInfo has to be called before and after SetConsoleScreenBufferSize othewise Windows has a fit
-		SetConsoleWindowInfo(consoleOut, true, &minSize);
-		if (!SetConsoleScreenBufferSize(consoleOut, sbSize))
+	//Set how frames are encoded into virtual terminal sequences
+	bool Window::SetEncoderSettings(EncoderSettings settings)
+	{
 		{
-			cvid::LogError("CVid error in Window: Failed to set console screen buffer size. Code " + std::to_string(GetLastError()));
-			throw "Failed to set console screen buffer size";
+			std::lock_guard<std::mutex> lock(outputMutex);
+			encoder.settings = settings;
+			encoder.Invalidate();
 		}
-		if (!SetConsoleWindowInfo(consoleOut, true, &consoleSize))
+
+		//The console app does its own encoding
+		if (seperateProcess)
+			return SendData(&settings, sizeof(settings), DataType::EncoderSettings);
+
+		return true;
+	}
+
+	//Get how frames are encoded into virtual terminal sequences
+	EncoderSettings Window::GetEncoderSettings()
+	{
+		std::lock_guard<std::mutex> lock(outputMutex);
+		return encoder.settings;
+	}
+
+	//Set how frames are presented, queueDepth is the most frames waiting in Queued mode
+	void Window::SetPresentMode(PresentMode mode, size_t queueDepth)
+	{
+		//Let the old present thread finish what it has
+		StopPresentThread();
+
+		presentMode = mode;
+		presentQueueDepth = std::max(queueDepth, (size_t)1);
+		presentFailed = false;
+
+		if (mode != PresentMode::Synchronous)
 		{
-			cvid::LogError("CVid error in Window: Failed to set console size. Code " + std::to_string(GetLastError()));
-			throw "Failed to set console screen buffer size";
+			stopPresenting = false;
+			presentThread = std::thread(&Window::PresentLoop, this);
 		}
 	}
 
+	//Get how frames are presented
+	PresentMode Window::GetPresentMode()
+	{
+		return presentMode;
+	}
+
 	//Draw the current framebuffer
 	bool Window::DrawFrame()
 	{
 		ClearDepthBuffer();
 
-		const size_t frameSize = (size_t)width * (height / 2);
+		if (!alive)
+			return false;
+
+		if (presentMode == PresentMode::Synchronous)
+			return PresentFrame(frameBuffer, width, height);
 
-		//Send to process if seperate
-		if (seperateProcess)
-			return SendData(frameBuffer, frameSize * sizeof(CharPixel), DataType::Frame);
-		//Draw the frame directly
-		else
+		//Hand a copy of the framebuffer to the present thread, the framebuffer keeps its contents
 		{
-			std::string frameString;
-			frameString.reserve((size_t)29 * width * (height / 2));
-
-			//Set colors to black
-			std::cout << "\x1b[38;2;0;0;0m\x1b[48;2;0;0;0m";
+			std::unique_lock<std::mutex> lock(presentMutex);
 
-			cvid::Color currentBg{ 0, 0, 0 };
-			cvid::Color currentFg{ 0, 0, 0 };
-			//For every pixel in the framebuffer
-			for (size_t y = 0; y < height / 2; y++)
+			if (presentMode == PresentMode::Queued)
 			{
-				//Windows 11 broke text wrapping, so do we it here. Also for some reason it starts from 1
-				frameString.append(std::format("\x1b[{};0f", y + 1));
-
-				for (size_t x = 0; x < width; x++)
+				//Wait for room in the queue
+				presentCondition.wait(lock, [&]() { return presentQueue.size() < presentQueueDepth; });
+			}
+			else
+			{
+				//Drop any frame which has not been presented yet
+				while (!presentQueue.empty())
 				{
-					cvid::CharPixel& thisPixel = frameBuffer[y * width + x];
-
-					//Change foreground color if it changes
-					if (thisPixel.fg.r != currentFg.r || thisPixel.fg.g != currentFg.g || thisPixel.fg.b != currentFg.b)
-					{
-						//Add the proper vts to the displayFrame
-						//Format: \x1b38;2;<r>;<g>;<b>;m
-						frameString.append(std::format("\x1b[38;2;{};{};{}m", thisPixel.fg.r, thisPixel.fg.g, thisPixel.fg.b));
-						currentFg = thisPixel.fg;
-					}
-					//Change background color if it changes
-					if (thisPixel.bg.r != currentBg.r || thisPixel.bg.g != currentBg.g || thisPixel.bg.b != currentBg.b)
-					{
-						//Add the proper vts to the displayFrame
-						//Format: \x1b48;2;<r>;<g>;<b>;m
-						frameString.append(std::format("\x1b[48;2;{};{};{}m", thisPixel.bg.r, thisPixel.bg.g, thisPixel.bg.b));
-						currentBg = thisPixel.bg;
-					}
-
-					frameString += thisPixel.character;
+					freeFrames.push_back(std::move(presentQueue.front()));
+					presentQueue.pop_front();
 				}
 			}
 
-			//Print the frame
-			std::cout << frameString;
-			return true;
+			//Reuse an old frame if possible
+			QueuedFrame frame;
+			if (!freeFrames.empty())
+			{
+				frame = std::move(freeFrames.back());
+				freeFrames.pop_back();
+			}
+			frame.pixels.assign(frameBuffer, frameBuffer + (size_t)width * (height / 2));
+			frame.width = width;
+			frame.height = height;
+			presentQueue.push_back(std::move(frame));
 		}
+		presentCondition.notify_all();
+
+		//Errors from the present thread show up a frame late
+		return !presentFailed.exchange(false) && alive;
 	}
 
-	//Send data to the window process
-	bool Window::SendData(const void* data, size_t amount, DataType type, bool block)
+	//Get how long encoding and writing the last frame took in seconds
+	double Window::GetPresentTime()
 	{
-		if (!alive)
+		return presentTime;
+	}
+
+	//Get how long the single write of the last frame took in seconds
+	double Window::GetWriteTime()
+	{
+		return writeTime;
+	}
+
+	//Does the console support synchronized output, asked once when the window is created
+	bool Window::SupportsSynchronizedOutput()
+	{
+		return synchronizedOutput;
+	}
+
+	//Get how long after being sent the last frame the window process drew took to draw, in seconds
+	double Window::GetViewerLag()
+	{
+		return viewerLag;
+	}
+
+	//Get how many frames the window process skipped because a newer one was already waiting
+	uint64_t Window::GetDroppedFrames()
+	{
+		return droppedFrames;
+	}
+
+	//Record every presented frame to a capture file for replaying, ends any recording in progress
+	bool Window::StartRecording(const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(recordMutex);
+		recorder.reset();
+		try
+		{
+			recorder = std::make_unique<FrameRecorder>(path);
+		}
+		catch (const std::runtime_error&)
+		{
 			return false;
+		}
+		return true;
+	}
 
-		//Only string works with main window
-		if (!seperateProcess)
+	//Finish the recording in progress
+	void Window::StopRecording()
+	{
+		std::lock_guard<std::mutex> lock(recordMutex);
+		recorder.reset();
+	}
+
+	//Encode and write a frame to the console, height is in pixels
+	bool Window::PresentFrame(const CharPixel* frame, uint16_t w, uint16_t h)
+	{
+		auto start = std::chrono::steady_clock::now();
+		bool presented = EncodeAndWrite(frame, w, h);
+		presentTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return presented;
+	}
+
+	//Encode and write a frame to the console or window process, height is in pixels
+	bool Window::EncodeAndWrite(const CharPixel* frame, uint16_t w, uint16_t h)
+	{
+		//Viewers have their own encoders since their terminals may show different frames than this console
+		if (broadcaster)
+			broadcaster->Broadcast(frame, w, h / 2);
+
+		{
+			std::lock_guard<std::mutex> lock(recordMutex);
+			if (recorder)
+				recorder->Record(frame, w, h / 2);
+		}
+
+		//Send to process if seperate
+		if (seperateProcess)
 		{
-			if (type == DataType::String)
+			//The frame goes through shared memory and only its sequence number through the pipe
+			//Frames go through the pipe compressed if they do not fit or the window process is behind
+			uint64_t sequence = frameRing ? frameRing->Write(frame, w, h / 2) : 0;
+			if (sequence != 0)
 			{
-				std::cout << (char*)data;
-				return true;
+				//The window process only diffs against frames from the pipe
+				frameCodec.Reset();
+				return SendFrame(&sequence, sizeof(sequence), DataType::SharedFrame);
 			}
-			else
+
+			//Mostly unchanged frames shrink to a few hundred bytes as the difference to the last one
+			bool delta;
+			const std::vector<uint8_t>& compressed = frameCodec.Compress(frame, w, h / 2, delta);
+			return SendFrame(compressed.data(), compressed.size(), delta ? DataType::DeltaFrame : DataType::CompressedFrame);
+		}
+
+		//Draw the frame directly, writing each band straight from the encoder
+		std::lock_guard<std::mutex> lock(outputMutex);
+		if (headless && !outputSink)
+			return true;
+		if (!headless && ConsoleChanged())
+			encoder.Invalidate();
+
+		const std::vector<std::string_view>& bands = encoder.EncodeBands(frame, w, h / 2);
+
+		//The console holds off drawing until the end of the frame, however many pieces it arrives in
+		frameParts.clear();
+		bool synchronize = synchronizedOutput && enableSynchronizedOutput;
+		if (synchronize)
+			frameParts.push_back("\x1b[?2026h");
+		frameParts.insert(frameParts.end(), bands.begin(), bands.end());
+		if (synchronize)
+			frameParts.push_back("\x1b[?2026l");
+
+		//The whole frame goes out in one write
+		auto start = std::chrono::steady_clock::now();
+		bool written = WriteOutput(frameParts);
+		writeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return written;
+	}
+
+	//Present queued frames until stopped
+	void Window::PresentLoop()
+	{
+		while (true)
+		{
+			QueuedFrame frame;
 			{
-				return false;
+				std::unique_lock<std::mutex> lock(presentMutex);
+				presentCondition.wait(lock, [&]() { return stopPresenting || !presentQueue.empty(); });
+
+				//Only stop once everything queued has been presented
+				if (presentQueue.empty())
+					return;
+
+				frame = std::move(presentQueue.front());
+				presentQueue.pop_front();
+				presenting = true;
+			}
+			//There is room in the queue again
+			presentCondition.notify_all();
+
+			if (!PresentFrame(frame.pixels.data(), frame.width, frame.height))
+				presentFailed = true;
+
+			//Keep the frame's memory for reuse
+			{
+				std::lock_guard<std::mutex> lock(presentMutex);
+				freeFrames.push_back(std::move(frame));
+				presenting = false;
 			}
+			//Resize may be waiting for it to be done
+			presentCondition.notify_all();
 		}
+	}
+
+	//Stop the present thread after it has drawn every queued frame
+	void Window::StopPresentThread()
+	{
+		if (!presentThread.joinable())
+			return;
 
-		//Make sure the window is still active
-		DWORD code;
-		if (!IsAlive(&code))
 		{
-			LogWarning("CVid warning in Window: Window exited unexpectedly, code " + std::to_string(code));
+			std::lock_guard<std::mutex> lock(presentMutex);
+			stopPresenting = true;
+		}
+		presentCondition.notify_all();
+		presentThread.join();
+	}
 
-			return false;
+	//Write some strings to the console, or outputSink if headless, must hold outputMutex
+	bool Window::WriteOutput(const std::vector<std::string_view>& parts)
+	{
+		if (!headless)
+			return WriteToConsole(parts);
+
+		if (outputSink)
+		{
+			for (std::string_view part : parts)
+				outputSink(part);
 		}
+		return true;
+	}
 
-		//Block untill app sends a ready status if specified
-		if (block)
+	//Create the shared memory frames are sent to the window process through and tell it about it
+	void Window::CreateFrameRing(const std::string& ringName)
+	{
+		//Big enough for the largest window possible, bigger frames go through the pipe instead
+#ifdef _WIN32
+		Vector2Int maxSize = MaxWindowSize();
+#else
+		Vector2Int maxSize(maxSharedFrameWidth, maxSharedFrameHeight);
+#endif
+		try
+		{
+			//A slot for every frame in flight and one being drawn
+			frameRing = std::make_unique<SharedFrameRing>(ringName, (size_t)maxSize.x * ((maxSize.y + 1) / 2), maxFramesInFlight + 1);
+		}
+		catch (const std::runtime_error&)
 		{
-			//Read the status data
-			char buffer[8];
-			DWORD numBytesRead = 0;
-			bool readPipeSuccess = ReadFile(
-				inPipe,
-				buffer, //The destination for the data from the pipe
-				1 * sizeof(char), //Attempt to read this many bytes
-				&numBytesRead,
-				NULL //Not using overlapped IO
-			);
+			LogWarning("CVid warning in Window: Sending frames through the pipe instead of shared memory");
+			return;
 		}
 
-		//Prefix the data with it's type
-		char* cdata = new char[amount + 1];
-		cdata[0] = (char)type;
-		memcpy(cdata + 1, data, amount);
+		if (!SendData(ringName.data(), ringName.size(), DataType::SharedRing))
+			frameRing.reset();
+	}
 
-		//Send the data
-		bool sendSuccess = WriteFile(
-			outPipe,
-			cdata,
-			(amount + 1) * sizeof(char), //How many bytes to send
-			NULL, NULL //Irrelevant
-		);
+	//Send a frame to the window process with its sequence number and the time
+	bool Window::SendFrame(const void* data, size_t amount, DataType type)
+	{
+		FrameInfo info;
+		info.sequence = ++frameSequence;
+		info.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+		frameMessage.resize(sizeof(info) + amount);
+		memcpy(frameMessage.data(), &info, sizeof(info));
+		memcpy(frameMessage.data() + sizeof(info), data, amount);
+		return SendData(frameMessage.data(), frameMessage.size(), type);
+	}
 
-		delete[] cdata;
+	//Look for the replies to synchronizedOutputQuery, returns true once the answer is known
+	bool Window::ParseSynchronizedOutputReply(std::string_view reply)
+	{
+		//Format: \x1b[?2026;<state>$y, 1 is set and 2 is reset, 0 is unknown and 4 is permanently off
+		constexpr std::string_view reportStart = "\x1b[?2026;";
+		size_t report = reply.find(reportStart);
+		size_t stateIndex = report + reportStart.size();
+		if (report != std::string_view::npos && reply.size() >= stateIndex + 3 && reply.substr(stateIndex + 1, 2) == "$y")
+		{
+			char state = reply[stateIndex];
+			synchronizedOutput = state == '1' || state == '2';
+			return true;
+		}
 
-		//Make sure the data was sent
-		if (!sendSuccess)
+		//The device attributes reply comes after the mode report, so if it is here there was no mode report
+		//Format: \x1b[?<attributes>c
+		size_t attributes = reply.find("\x1b[?");
+		while (attributes != std::string_view::npos)
 		{
-			LogWarning("CVid warning in Window: Failed to send data to window, code " + std::to_string(GetLastError()));
-			return false;
+			size_t end = reply.find_first_not_of("0123456789;", attributes + 3);
+			if (end != std::string_view::npos && reply[end] == 'c')
+			{
+				synchronizedOutput = false;
+				return true;
+			}
+			attributes = reply.find("\x1b[?", attributes + 3);
 		}
-		return true;
+		return false;
 	}
 
 	//Closes the window process
@@ -503,79 +1141,122 @@ namespace cvid
 	{
 		if (!alive)
 			return;
-		if (seperateProcess)
-		{
-			//Close all handles.
-			CloseHandle(processInfo.hProcess);
-			CloseHandle(processInfo.hThread);
-			CloseHandle(outPipe);
 
-			//Call onClose if applicable
-			if (onClose)
-				onClose(this);
+		//The present thread can end up here if the window process dies, it skips StopPresentThread so it does not join itself
+		//It keeps emptying the queue until stopPresenting is set, ~Window stops and joins it later
+		if (std::this_thread::get_id() != presentThread.get_id())
+			StopPresentThread();
 
-			alive = false;
+		//Call onClose if applicable
+		if (onClose)
+			onClose(this);
 
-			delete[] frameBuffer;
-			delete[] depthBuffer;
-		}
-		else
-		{
-			system("cls");
-			//Reset Color and show cursor
-			std::cout << "\x1b[38;2;204;204;204m\x1b[48;2;12;12;12m\x1b[?25h";
-			//Restore original properties
-			SMALL_RECT minSize{ 0, 0, 1, 1 };
-			SetConsoleWindowInfo(consoleOut, true, &minSize);
-			SetConsoleScreenBufferSize(consoleOut, originalSbSize);
-			SetConsoleWindowInfo(consoleOut, true, &originalSize);
-			SetConsoleMode(consoleIn, originalMode);
-			SetConsoleTitle(originalTitle);
-		}
+		if (!headless)
+			CloseConsole();
+
+		alive = false;
 	}
 
-	//Return true if the window process is still active
-	bool Window::IsAlive(DWORD* exitCode)
+	//Get the dimensions of this window. Y is in pixel coordinates
+	Vector2Int Window::GetSize()
 	{
-		if (alive && seperateProcess)
+		return Vector2Int(width, height);
+	}
+
+	//Get the colors of the top and bottom pixel of a character as it is shown
+	static void CharPixelColors(const CharPixel& charPixel, Color& top, Color& bottom)
+	{
+		switch ((uint8_t)charPixel.character)
 		{
-			DWORD code;
-			GetExitCodeProcess(processInfo.hProcess, &code);
-			//If not alive close the handles
-			if (code != STILL_ACTIVE)
-			{
-				CloseWindow();
-			}
-			if (exitCode)
-				*exitCode = code;
+		case 223: //Upper half block
+			top = charPixel.fg;
+			bottom = charPixel.bg;
+			break;
+		case 220: //Lower half block
+			top = charPixel.bg;
+			bottom = charPixel.fg;
+			break;
+		case 219: //Full block
+			top = charPixel.fg;
+			bottom = charPixel.fg;
+			break;
+		default: //Space or text, mostly background
+			top = charPixel.bg;
+			bottom = charPixel.bg;
+			break;
 		}
+	}
+
+	//Get the color a pixel of the framebuffer is shown as
+	Color Window::GetPixel(uint16_t x, uint16_t y)
+	{
+		//Make sure the pixel is in bounds
+		if (x >= width || y >= height)
+			return Color{};
+
+		Color top, bottom;
+		CharPixelColors(frameBuffer[((height - 1 - y) / 2) * width + x], top, bottom);
 
-		return alive;
+		//Odd rows are the top of a character
+		Color color = y % 2 == 0 ? bottom : top;
+		color.a = 255;
+		return color;
 	}
 
-	//Get the input record of this console window
-	std::vector<INPUT_RECORD> Window::GetInputRecord()
+	//Save the framebuffer as it is shown to a binary PPM image, returns true on success
+	bool Window::SaveFrame(const std::string& path)
 	{
-		//Get the input from console
-		INPUT_RECORD inputRecord[128];
-		DWORD numRead;
-		PeekConsoleInput(consoleIn, inputRecord, 128, &numRead);
-		FlushConsoleInputBuffer(consoleIn);
+		std::ofstream file(path, std::ios::binary);
+		if (!file)
+		{
+			LogWarning("CVid warning in Window: Could not open " + path + " for writing");
+			return false;
+		}
 
-		//Put it in a vector for ease of use
-		std::vector<INPUT_RECORD> recordVec;
-		recordVec.reserve(numRead);
-		for (size_t i = 0; i < numRead; i++)
+		file << "P6\n" << width << " " << height << "\n255\n";
+
+		//Images go top to bottom
+		std::vector<char> row((size_t)width * 3);
+		for (int y = height - 1; y >= 0; y--)
 		{
-			recordVec.push_back(inputRecord[i]);
+			for (uint16_t x = 0; x < width; x++)
+			{
+				Color color = GetPixel(x, y);
+				row[(size_t)x * 3] = color.r;
+				row[(size_t)x * 3 + 1] = color.g;
+				row[(size_t)x * 3 + 2] = color.b;
+			}
+			file.write(row.data(), row.size());
 		}
 
-		return recordVec;
+		return (bool)file;
 	}
 
-	//Get the dimensions of this window. Y is in pixel coordinates
-	Vector2Int Window::GetSize()
+	//Get a hash of the framebuffer as it is shown, equal frames have equal hashes
+	uint64_t Window::HashFrame()
 	{
-		return Vector2Int(width, height);
+		//64-bit FNV-1a over the dimensions and the rgb of every pixel
+		uint64_t hash = 14695981039346656037ull;
+		auto hashByte = [&](uint8_t byte)
+			{
+				hash ^= byte;
+				hash *= 1099511628211ull;
+			};
+
+		hashByte(width & 0xFF);
+		hashByte(width >> 8);
+		hashByte(height & 0xFF);
+		hashByte(height >> 8);
+		for (uint16_t y = 0; y < height; y++)
+		{
+			for (uint16_t x = 0; x < width; x++)
+			{
+				Color color = GetPixel(x, y);
+				hashByte(color.r);
+				hashByte(color.g);
+				hashByte(color.b);
+			}
+		}
+		return hash;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,523 @@
+#ifndef _WIN32
+#include <cvid/Window.h>
+#include <cvid/Helpers.h>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <format>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+namespace cvid
+{
+	//Set by the SIGWINCH handler, there is only one terminal per process so it is shared by every window
+	static volatile std::sig_atomic_t terminalResized = 0;
+
+	static void OnTerminalResized(int)
+	{
+		terminalResized = 1;
+	}
+
+	//Most strings given to a single writev, well under IOV_MAX everywhere
+	constexpr int maxWriteParts = 64;
+	//Longest wait for the window process to connect in milliseconds, a terminal emulator can take a while to start
+	constexpr int processConnectTimeout = 10000;
+
+#ifdef MSG_NOSIGNAL
+	constexpr int sendFlags = MSG_NOSIGNAL;
+#else
+	constexpr int sendFlags = 0;
+#endif
+
+	//Quote a string for /bin/sh
+	static std::string ShellQuote(const std::string& string)
+	{
+		std::string quoted = "'";
+		for (char c : string)
+		{
+			if (c == '\'')
+				quoted += "'\\''";
+			else
+				quoted += c;
+		}
+		return quoted + "'";
+	}
+
+	//Find ConsoleWindowApp, from CVID_WINDOW_APP, next to this executable, or on the PATH
+	static std::string FindWindowApp()
+	{
+		if (const char* app = getenv("CVID_WINDOW_APP"))
+			return app;
+
+		char path[4096];
+		ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+		if (length > 0)
+		{
+			std::string appPath(path, length);
+			appPath = appPath.substr(0, appPath.find_last_of('/') + 1) + "ConsoleWindowApp";
+			if (access(appPath.c_str(), X_OK) == 0)
+				return appPath;
+		}
+		return "ConsoleWindowApp";
+	}
+
+	//Send all of some bytes through a socket, returns false on failure
+	static bool SendAll(int socket, const char* data, size_t size)
+	{
+		while (size > 0)
+		{
+			ssize_t sent = send(socket, data, size, sendFlags);
+			if (sent < 0 && errno == EINTR)
+				continue;
+			if (sent <= 0)
+				return false;
+			data += sent;
+			size -= sent;
+		}
+		return true;
+	}
+
+	Vector2Int MaxWindowSize()
+	{
+		//Not a terminal, so there is nothing limiting the size
+		winsize size;
+		if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0 || size.ws_col == 0 || size.ws_row == 0)
+			return Vector2Int(INT16_MAX, INT16_MAX);
+
+		return Vector2Int(size.ws_col, size.ws_row * 2);
+	}
+
+	//Create this window using the main application's terminal
+	void Window::CreateAsMain(std::string name)
+	{
+		terminalOut = STDOUT_FILENO;
+		terminalIn = STDIN_FILENO;
+
+		//Switch to raw input so keys are not echoed and reads never block, not an error if input is not a terminal
+		if (tcgetattr(terminalIn, &originalTermios) == 0)
+		{
+			termios raw = originalTermios;
+			raw.c_lflag &= ~(ICANON | ECHO);
+			raw.c_cc[VMIN] = 0;
+			raw.c_cc[VTIME] = 0;
+			if (tcsetattr(terminalIn, TCSANOW, &raw) == 0)
+				termiosChanged = true;
+		}
+
+		//Redraw everything when the terminal is resized
+		struct sigaction resizeAction;
+		memset(&resizeAction, 0, sizeof(resizeAction));
+		resizeAction.sa_handler = OnTerminalResized;
+		sigemptyset(&resizeAction.sa_mask);
+		resizeAction.sa_flags = SA_RESTART;
+		sigaction(SIGWINCH, &resizeAction, &originalResizeAction);
+
+		//Rename window, switch to the alternate screen, and hide the cursor
+		std::string setup = "\x1b]0;" + name + "\x07\x1b[?1049h\x1b[2J\x1b[?25l";
+		std::lock_guard<std::mutex> lock(outputMutex);
+		WriteOutput({ setup });
+
+		QuerySynchronizedOutput();
+	}
+
+	//Ask the terminal if it supports synchronized output, waits for the reply up to a timeout
+	void Window::QuerySynchronizedOutput()
+	{
+		//Replies come in as input, which only works without line buffering
+		if (!termiosChanged)
+			return;
+
+		WriteToConsole({ synchronizedOutputQuery });
+
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(synchronizedOutputTimeout);
+		std::string reply;
+		char buffer[64];
+		while (!ParseSynchronizedOutputReply(reply))
+		{
+			int remaining = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			pollfd pending{ terminalIn, POLLIN, 0 };
+			if (remaining <= 0 || poll(&pending, 1, remaining) <= 0)
+				break;
+
+			ssize_t numRead = read(terminalIn, buffer, sizeof(buffer));
+			if (numRead <= 0)
+				break;
+			reply.append(buffer, numRead);
+		}
+
+		//Keep anything typed meanwhile for GetInput, minus the replies
+		size_t replyStart = reply.find("\x1b[?");
+		pendingInput = reply.substr(0, replyStart);
+		if (replyStart != std::string::npos)
+		{
+			size_t replyEnd = reply.find_last_of('c');
+			if (replyEnd != std::string::npos && replyEnd > replyStart)
+				pendingInput += reply.substr(replyEnd + 1);
+		}
+	}
+
+	//Create this window as a new process
+	//ConsoleWindowApp is started in a new terminal emulator given by CVID_TERMINAL, xterm by default
+	//If CVID_TERMINAL is empty the command to start it is printed instead, to run in any terminal by hand
+	void Window::CreateAsNewProcess(std::string name)
+	{
+		//Listen on a socket for the window process to connect to
+		std::string socketPath = std::format("/tmp/cvid{}window{}.sock", getpid(), numWindowsCreated);
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+		unlink(socketPath.c_str());
+
+		int listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listenSocket < 0 || bind(listenSocket, (sockaddr*)&address, sizeof(address)) != 0 || listen(listenSocket, 1) != 0)
+		{
+			LogError("CVid error in Window: Failed to create socket, " + std::string(strerror(errno)));
+			if (listenSocket >= 0)
+				close(listenSocket);
+			throw std::runtime_error("Failed to create socket");
+		}
+
+		//Start the window process
+		const char* terminal = getenv("CVID_TERMINAL");
+		std::string command = ShellQuote(FindWindowApp()) + " " + ShellQuote(socketPath) + " " + ShellQuote(name);
+		if (terminal && terminal[0] == '\0')
+		{
+			std::cout << "Run this to open window " << name << ":\n" << command << std::endl;
+		}
+		else
+		{
+			command = "exec " + std::string(terminal ? terminal : "xterm -e") + " " + command;
+			processId = fork();
+			if (processId == 0)
+			{
+				//Keep the terminal out of this process' signals
+				setsid();
+				execl("/bin/sh", "sh", "-c", command.c_str(), (char*)nullptr);
+				_exit(127);
+			}
+			if (processId < 0)
+			{
+				LogError("CVid error in Window: Failed to create window process, " + std::string(strerror(errno)));
+				close(listenSocket);
+				unlink(socketPath.c_str());
+				throw std::runtime_error("Failed to create process");
+			}
+		}
+
+		//Wait for the window process to connect, giving up if its terminal exits first
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(processConnectTimeout);
+		while (processSocket < 0)
+		{
+			int remaining = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			int status;
+			bool exited = processId > 0 && waitpid(processId, &status, WNOHANG) == processId;
+			//Someone starting it by hand gets as long as they need
+			if (exited || (processId > 0 && remaining <= 0))
+			{
+				LogError("CVid error in Window: Window process did not connect, check CVID_TERMINAL and CVID_WINDOW_APP");
+				if (!exited)
+				{
+					kill(processId, SIGTERM);
+					waitpid(processId, &status, 0);
+				}
+				close(listenSocket);
+				unlink(socketPath.c_str());
+				throw std::runtime_error("Failed to connect socket");
+			}
+
+			pollfd pending{ listenSocket, POLLIN, 0 };
+			if (poll(&pending, 1, 100) > 0)
+				processSocket = accept(listenSocket, nullptr, nullptr);
+		}
+		close(listenSocket);
+		unlink(socketPath.c_str());
+
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+		int noSigPipe = 1;
+		setsockopt(processSocket, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+
+		//The window process sends a status when it has started, like for a message
+		messagesInFlight = 1;
+
+		//Frames go through shared memory from now on
+		CreateFrameRing(std::format("/cvidprocess{}window{}frames", getpid(), numWindowsCreated));
+	}
+
+	//Resize the terminal to fit the frame
+	void Window::ResizeMain(int16_t w, int16_t h)
+	{
+		//Terminals can not be resized reliably, xterm compatible ones take this and the rest ignore it
+		std::string resize = "\x1b[8;" + std::to_string((h + 1) / 2) + ";" + std::to_string(w) + "t\x1b[2J";
+		std::lock_guard<std::mutex> lock(outputMutex);
+		WriteOutput({ resize });
+	}
+
+	//Write some strings to the terminal in order with as few system calls as possible, must hold outputMutex
+	bool Window::WriteToConsole(const std::vector<std::string_view>& parts)
+	{
+		//Anything written through std::cout has to go out first
+		std::cout.flush();
+
+		iovec vectors[maxWriteParts];
+		size_t nextPart = 0;
+		while (nextPart < parts.size())
+		{
+			//Gather the next parts, skipping empty ones
+			int count = 0;
+			for (; nextPart < parts.size() && count < maxWriteParts; nextPart++)
+			{
+				if (parts[nextPart].empty())
+					continue;
+				vectors[count].iov_base = (void*)parts[nextPart].data();
+				vectors[count].iov_len = parts[nextPart].size();
+				count++;
+			}
+
+			iovec* remaining = vectors;
+			while (count > 0)
+			{
+				ssize_t written = writev(terminalOut, remaining, count);
+				if (written < 0)
+				{
+					if (errno == EINTR)
+						continue;
+
+					//Non blocking output, wait for the terminal to catch up
+					if (errno == EAGAIN || errno == EWOULDBLOCK)
+					{
+						pollfd output{ terminalOut, POLLOUT, 0 };
+						poll(&output, 1, -1);
+						continue;
+					}
+
+					LogWarning("CVid warning in Window: Failed to write to terminal, " + std::string(strerror(errno)));
+					return false;
+				}
+
+				//The terminal can take less than everything, skip what was written
+				while (count > 0 && (size_t)written >= remaining->iov_len)
+				{
+					written -= remaining->iov_len;
+					remaining++;
+					count--;
+				}
+				if (count > 0)
+				{
+					remaining->iov_base = (char*)remaining->iov_base + written;
+					remaining->iov_len -= written;
+				}
+			}
+		}
+		return true;
+	}
+
+	//Has the terminal been resized since the last call, must hold outputMutex
+	bool Window::ConsoleChanged()
+	{
+		if (!terminalResized)
+			return false;
+		terminalResized = 0;
+
+		//The terminal reflows or drops what was on it, start from a clean screen
+		WriteToConsole({ "\x1b[2J" });
+		return true;
+	}
+
+	//Send data to the terminal or window process
+	bool Window::SendData(const void* data, size_t amount, DataType type, bool block)
+	{
+		if (!alive)
+			return false;
+
+		//Only strings work without a window process
+		if (!seperateProcess)
+		{
+			if (type != DataType::String)
+				return false;
+
+			//Frames from the present thread and data from the caller must not interleave
+			std::lock_guard<std::mutex> lock(outputMutex);
+			return WriteOutput({ std::string_view((const char*)data) });
+		}
+
+		//Make sure the window is still active
+		ExitCode code;
+		if (!IsAlive(&code))
+		{
+			LogWarning("CVid warning in Window: Window exited unexpectedly, code " + std::to_string(code));
+			return false;
+		}
+
+		//Frames from the present thread and data from the caller must not interleave
+		std::lock_guard<std::mutex> lock(outputMutex);
+
+		//Keep up to maxFramesInFlight messages in the socket, if specified block untill the app has handled one when there are more
+		if (!ReadStatus(false))
+			return false;
+		while (block && messagesInFlight >= std::max<uint16_t>(maxFramesInFlight, 1))
+		{
+			if (!ReadStatus(true))
+				return false;
+		}
+
+		//Prefix the data with its size and type, the socket is a stream
+		char header[sizeof(uint32_t) + 1];
+		uint32_t size = (uint32_t)amount + 1;
+		memcpy(header, &size, sizeof(size));
+		header[sizeof(size)] = (char)type;
+
+		if (!SendAll(processSocket, header, sizeof(header)) || !SendAll(processSocket, (const char*)data, amount))
+		{
+			LogWarning("CVid warning in Window: Failed to send data to window, " + std::string(strerror(errno)));
+			return false;
+		}
+		messagesInFlight++;
+		return true;
+	}
+
+	//Handle the statuses the window process has sent, waiting for one first if wait is set
+	bool Window::ReadStatus(bool wait)
+	{
+		constexpr size_t statusSize = 1 + sizeof(FrameStatus);
+		while (true)
+		{
+			//Stop once there are no more whole statuses unless waiting for one
+			if (!wait)
+			{
+				int available = 0;
+				if (ioctl(processSocket, FIONREAD, &available) != 0)
+				{
+					LogWarning("CVid warning in Window: Failed to read from window, " + std::string(strerror(errno)));
+					return false;
+				}
+				if ((size_t)available < statusSize)
+					return true;
+			}
+			wait = false;
+
+			//Read the status data
+			char buffer[statusSize];
+			size_t totalRead = 0;
+			while (totalRead < statusSize)
+			{
+				ssize_t numRead = recv(processSocket, buffer + totalRead, statusSize - totalRead, 0);
+				if (numRead < 0 && errno == EINTR)
+					continue;
+				if (numRead <= 0)
+				{
+					LogWarning("CVid warning in Window: Failed to read from window, " + std::string(numRead == 0 ? "it closed" : strerror(errno)));
+					return false;
+				}
+				totalRead += numRead;
+			}
+
+			if (messagesInFlight > 0)
+				messagesInFlight--;
+
+			FrameStatus status;
+			memcpy(&status, buffer + 1, sizeof(status));
+			if (status.sequence == 0)
+				continue;
+
+			//Only this process' clock is used, the timestamp is the one sent with the frame
+			if (status.presented)
+			{
+				int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+				viewerLag = (now - status.timestamp) / 1e9;
+			}
+			else
+			{
+				droppedFrames++;
+			}
+		}
+	}
+
+	//Restore the terminal to how it was, or end the window process
+	void Window::CloseConsole()
+	{
+		if (seperateProcess)
+		{
+			//Closing the socket makes the window process exit, which closes its terminal
+			close(processSocket);
+			processSocket = -1;
+			frameRing.reset();
+			if (processId > 0)
+			{
+				int status;
+				if (waitpid(processId, &status, 0) == processId && WIFEXITED(status))
+					processExitCode = WEXITSTATUS(status);
+				processId = -1;
+			}
+			return;
+		}
+
+		{
+			//Reset color, show cursor, and go back to the normal screen
+			std::lock_guard<std::mutex> lock(outputMutex);
+			WriteToConsole({ "\x1b[0m\x1b[?25h\x1b[?1049l" });
+		}
+
+		if (termiosChanged)
+		{
+			tcsetattr(terminalIn, TCSANOW, &originalTermios);
+			termiosChanged = false;
+		}
+		sigaction(SIGWINCH, &originalResizeAction, nullptr);
+	}
+
+	//Return true if the window is still active, optionally gives back the exit code of the window process
+	bool Window::IsAlive(ExitCode* exitCode)
+	{
+		if (alive && seperateProcess)
+		{
+			//The window process is gone once its end of the socket is closed
+			pollfd connection{ processSocket, 0, 0 };
+			bool closed = poll(&connection, 1, 0) > 0 && (connection.revents & (POLLHUP | POLLERR));
+			int status;
+			if (processId > 0 && waitpid(processId, &status, WNOHANG) == processId)
+			{
+				closed = true;
+				processExitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+				processId = -1;
+			}
+			if (closed)
+				CloseWindow();
+		}
+
+		if (exitCode)
+			*exitCode = processExitCode;
+		return alive;
+	}
+
+	//Get the bytes typed into the terminal since the last call, never blocks
+	std::string Window::GetInput()
+	{
+		std::string input = std::move(pendingInput);
+		pendingInput.clear();
+		char buffer[256];
+		while (true)
+		{
+			//Input may not be a raw terminal, so make sure read will not block
+			pollfd pending{ terminalIn, POLLIN, 0 };
+			if (poll(&pending, 1, 0) <= 0 || !(pending.revents & POLLIN))
+				break;
+
+			ssize_t numRead = read(terminalIn, buffer, sizeof(buffer));
+			if (numRead <= 0)
+				break;
+			input.append(buffer, numRead);
+		}
+		return input;
+	}
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,453 @@
+#ifdef _WIN32
+#include <cvid/Window.h>
+#include <cvid/Helpers.h>
+#include <format>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+
+namespace cvid
+{
+	Vector2Int MaxWindowSize()
+	{
+		HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+		return Vector2Int(GetLargestConsoleWindowSize(console).X, GetLargestConsoleWindowSize(console).Y * 2);
+	};
+
+	//Create this window using the main application's console
+	void Window::CreateAsMain(std::string name)
+	{
+		//Get the console handle
+		consoleOut = GetStdHandle(STD_OUTPUT_HANDLE);
+		consoleIn = GetStdHandle(STD_INPUT_HANDLE);
+
+		//Save the original window stats
+		CONSOLE_SCREEN_BUFFER_INFO origInfo;
+		GetConsoleScreenBufferInfo(consoleOut, &origInfo);
+		originalSize = origInfo.srWindow;
+		originalSbSize = origInfo.dwSize;
+		GetConsoleTitle(originalTitle, sizeof(originalTitle));
+
+		//Enable virtual terminal processing
+		SetConsoleMode(consoleOut, ENABLE_VIRTUAL_TERMINAL_PROCESSING | ENABLE_PROCESSED_OUTPUT);
+		//Disable quick edit
+		originalMode = 0;
+		GetConsoleMode(consoleIn, &originalMode);
+		SetConsoleMode(consoleIn, (originalMode & ~ENABLE_QUICK_EDIT_MODE) | ENABLE_WINDOW_INPUT | ENABLE_MOUSE_INPUT);
+		//Rename window
+		SetConsoleTitle(name.c_str());
+
+		//Hide the cursor
+		std::cout << "\x1b[?25l";
+
+		QuerySynchronizedOutput();
+	}
+
+	//Ask the console if it supports synchronized output, waits for the reply up to a timeout
+	void Window::QuerySynchronizedOutput()
+	{
+		//Replies only come in as input with virtual terminal input enabled
+		DWORD inputMode = 0;
+		GetConsoleMode(consoleIn, &inputMode);
+		if (!SetConsoleMode(consoleIn, inputMode | ENABLE_VIRTUAL_TERMINAL_INPUT))
+			return;
+
+		WriteToConsole({ synchronizedOutputQuery });
+
+		ULONGLONG deadline = GetTickCount64() + synchronizedOutputTimeout;
+		std::string reply;
+		while (!ParseSynchronizedOutputReply(reply))
+		{
+			ULONGLONG now = GetTickCount64();
+			if (now >= deadline || WaitForSingleObject(consoleIn, (DWORD)(deadline - now)) != WAIT_OBJECT_0)
+				break;
+
+			//The reply arrives as key presses
+			INPUT_RECORD records[64];
+			DWORD numRead = 0;
+			if (!ReadConsoleInputA(consoleIn, records, 64, &numRead))
+				break;
+			for (DWORD i = 0; i < numRead; i++)
+			{
+				if (records[i].EventType == KEY_EVENT && records[i].Event.KeyEvent.bKeyDown && records[i].Event.KeyEvent.uChar.AsciiChar)
+					reply += records[i].Event.KeyEvent.uChar.AsciiChar;
+			}
+		}
+
+		SetConsoleMode(consoleIn, inputMode);
+	}
+
+	//Create this window as a new process
+	void Window::CreateAsNewProcess(std::string name)
+	{
+		//Create the outbound pipe to the new console process
+		unsigned int pid = GetCurrentProcessId();
+		std::string genericPipeName = std::format("\\\\.\\pipe\\process{}window{}", pid, numWindowsCreated);
+		outPipeName = genericPipeName + "out";
+		outPipe = CreateNamedPipeA(
+			outPipeName.c_str(),
+			PIPE_ACCESS_OUTBOUND,
+			PIPE_TYPE_MESSAGE | PIPE_READMODE_BYTE | PIPE_NOWAIT,
+			1, //Max instances
+			16386, //Output buffer size 
+			0, //Input buffer size
+			1000, //Time out in ms
+			NULL //Security attributes
+		);
+		//Make sure the pipe creation worked
+		if (outPipe == NULL || outPipe == INVALID_HANDLE_VALUE)
+		{
+			LogError("CVid error in Window: Failed to create pipe, code " + std::to_string(GetLastError()));
+			throw std::runtime_error("Failed to create pipe");
+			return;
+		}
+
+		//Create the inbound pipe from the new console process
+		inPipeName = genericPipeName + "in";
+		inPipe = CreateNamedPipeA(
+			inPipeName.c_str(),
+			PIPE_ACCESS_INBOUND,
+			PIPE_TYPE_MESSAGE | PIPE_READMODE_BYTE | PIPE_WAIT,
+			1, //Max instances
+			0, //Output buffer size 
+			256, //Input buffer size
+			50, //Time out in ms
+			NULL //Security attributes
+		);
+		//Make sure the pipe creation worked
+		if (inPipe == NULL || inPipe == INVALID_HANDLE_VALUE)
+		{
+			LogError("CVid error in Window: Failed to create pipe, code " + std::to_string(GetLastError()));
+			throw std::runtime_error("Failed to create pipe");
+			return;
+		}
+
+		//Create an instance of the ConsoleWindowApp
+		//Setup startup info
+		STARTUPINFO startupInfo;
+		ZeroMemory(&startupInfo, sizeof(startupInfo));
+		ZeroMemory(&processInfo, sizeof(processInfo));
+		startupInfo.cb = sizeof(startupInfo);
+		startupInfo.lpTitle = name.data();
+
+		//Create the process
+		std::string cmdline("ConsoleWindowApp.exe ");
+		cmdline.append(genericPipeName);
+		bool createProcessSuccess = CreateProcessA(
+			NULL, //App name, default to cmd
+			cmdline.data(), //Comand line, send the pipe name
+			NULL, NULL, //Security attributes
+			false, //Inherit handles
+			NORMAL_PRIORITY_CLASS | CREATE_NEW_CONSOLE | CREATE_NEW_PROCESS_GROUP, //Creation flags
+			NULL, NULL, //Irrelevant
+			&startupInfo,
+			&processInfo
+		);
+		//Make sure the process creation worked
+		if (!createProcessSuccess)
+		{
+			LogError("CVid error in Window: Failed to create window process, code " + std::to_string(GetLastError()));
+			throw std::runtime_error("Failed to create process");
+			return;
+		}
+
+		//Connect the pipes
+		bool connectPipeSuccess = ConnectNamedPipe(inPipe, NULL);
+		if (!connectPipeSuccess)
+		{
+			//Some other error
+			LogError("CVid error in Window: Failed to connect pipe, code " + std::to_string(GetLastError()));
+			CloseHandle(inPipe);
+			throw std::runtime_error("Failed to connect pipe");
+			return;
+		}
+
+		connectPipeSuccess = ConnectNamedPipe(outPipe, NULL);
+		//Make sure the pipe connected successfully
+		while (!connectPipeSuccess)
+		{
+			//Wait for process to connect
+			if (GetLastError() == ERROR_PIPE_LISTENING)
+			{
+				connectPipeSuccess = ConnectNamedPipe(outPipe, NULL);
+				continue;
+			}
+
+			if (GetLastError() == ERROR_PIPE_CONNECTED)
+				break;
+
+			//Some other error
+			LogError("CVid error in Window: Failed to connect pipe, code " + std::to_string(GetLastError()));
+			CloseHandle(outPipe);
+			throw std::runtime_error("Failed to connect pipe");
+			return;
+		}
+
+		//Several messages can be in the pipe at once now, so writes have to wait for room instead of failing
+		DWORD pipeMode = PIPE_READMODE_BYTE | PIPE_WAIT;
+		SetNamedPipeHandleState(outPipe, &pipeMode, NULL, NULL);
+
+		//The window process sends a status when it has started, like for a message
+		messagesInFlight = 1;
+
+		//Frames go through shared memory from now on
+		CreateFrameRing(std::format("Local\\cvidprocess{}window{}frames", pid, numWindowsCreated));
+	}
+
+	//Resize the console to fit the frame
+	void Window::ResizeMain(int16_t w, int16_t h)
+	{
+		SMALL_RECT minSize{ 0, 0, 1, 1 };
+		SMALL_RECT consoleSize{ 0, 0, w - 1, (short)ceil((float)h / 2) - 1 };
+		COORD sbSize{ w, (short)ceil((float)h / 2) };
+
+		//SetConsoleWindowInfo has to be called before and after SetConsoleScreenBufferSize othewise Windows has a fit
+		SetConsoleWindowInfo(consoleOut, true, &minSize);
+		if (!SetConsoleScreenBufferSize(consoleOut, sbSize))
+		{
+			cvid::LogError("CVid error in Window: Failed to set console screen buffer size. Code " + std::to_string(GetLastError()));
+			throw "Failed to set console screen buffer size";
+		}
+		if (!SetConsoleWindowInfo(consoleOut, true, &consoleSize))
+		{
+			cvid::LogError("CVid error in Window: Failed to set console size. Code " + std::to_string(GetLastError()));
+			throw "Failed to set console screen buffer size";
+		}
+	}
+
+	//Write some strings to the console in one write, must hold outputMutex
+	bool Window::WriteToConsole(const std::vector<std::string_view>& parts)
+	{
+		//Anything written through std::cout has to go out first
+		std::cout.flush();
+
+		//The console has no gathering write, so join everything into one buffer
+		size_t total = 0;
+		for (std::string_view part : parts)
+			total += part.size();
+		if (outputBuffer.size() < total)
+			outputBuffer.resize(total);
+		char* out = outputBuffer.data();
+		for (std::string_view part : parts)
+		{
+			memcpy(out, part.data(), part.size());
+			out += part.size();
+		}
+
+		//WriteFile can take less than everything
+		size_t written = 0;
+		while (written < total)
+		{
+			DWORD numWritten = 0;
+			if (!WriteFile(consoleOut, outputBuffer.data() + written, (DWORD)(total - written), &numWritten, NULL))
+			{
+				LogWarning("CVid warning in Window: Failed to write to console, code " + std::to_string(GetLastError()));
+				return false;
+			}
+			written += numWritten;
+		}
+		return true;
+	}
+
+	//Has the console been changed externally since the last call, must hold outputMutex
+	bool Window::ConsoleChanged()
+	{
+		//The console is resized by Resize only
+		return false;
+	}
+
+	//Send data to the window process
+	bool Window::SendData(const void* data, size_t amount, DataType type, bool block)
+	{
+		if (!alive)
+			return false;
+
+		//Only string works with main window
+		if (!seperateProcess)
+		{
+			if (type == DataType::String)
+			{
+				//Frames from the present thread and data from the caller must not interleave
+				std::lock_guard<std::mutex> lock(outputMutex);
+				return WriteOutput({ std::string_view((const char*)data) });
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		//Make sure the window is still active
+		ExitCode code;
+		if (!IsAlive(&code))
+		{
+			LogWarning("CVid warning in Window: Window exited unexpectedly, code " + std::to_string(code));
+
+			return false;
+		}
+
+		//Frames from the present thread and data from the caller must not interleave
+		std::lock_guard<std::mutex> lock(outputMutex);
+
+		//Keep up to maxFramesInFlight messages in the pipe, if specified block untill the app has handled one when there are more
+		if (!ReadStatus(false))
+			return false;
+		while (block && messagesInFlight >= std::max<uint16_t>(maxFramesInFlight, 1))
+		{
+			if (!ReadStatus(true))
+				return false;
+		}
+
+		//Prefix the data with it's type
+		char* cdata = new char[amount + 1];
+		cdata[0] = (char)type;
+		memcpy(cdata + 1, data, amount);
+
+		//Send the data
+		bool sendSuccess = WriteFile(
+			outPipe,
+			cdata,
+			(amount + 1) * sizeof(char), //How many bytes to send
+			NULL, NULL //Irrelevant
+		);
+
+		delete[] cdata;
+
+		//Make sure the data was sent
+		if (!sendSuccess)
+		{
+			LogWarning("CVid warning in Window: Failed to send data to window, code " + std::to_string(GetLastError()));
+			return false;
+		}
+		messagesInFlight++;
+		return true;
+	}
+
+	//Handle the statuses the window process has sent, waiting for one first if wait is set
+	bool Window::ReadStatus(bool wait)
+	{
+		constexpr DWORD statusSize = 1 + sizeof(FrameStatus);
+		while (true)
+		{
+			//Stop once there are no more whole statuses unless waiting for one
+			if (!wait)
+			{
+				DWORD available = 0;
+				if (!PeekNamedPipe(inPipe, NULL, 0, NULL, &available, NULL))
+				{
+					LogWarning("CVid warning in Window: Failed to read from window, code " + std::to_string(GetLastError()));
+					return false;
+				}
+				if (available < statusSize)
+					return true;
+			}
+			wait = false;
+
+			//Read the status data
+			char buffer[statusSize];
+			DWORD totalRead = 0;
+			while (totalRead < statusSize)
+			{
+				DWORD numBytesRead = 0;
+				bool readPipeSuccess = ReadFile(
+					inPipe,
+					buffer + totalRead, //The destination for the data from the pipe
+					statusSize - totalRead, //Attempt to read this many bytes
+					&numBytesRead,
+					NULL //Not using overlapped IO
+				);
+				if (!readPipeSuccess || numBytesRead == 0)
+				{
+					LogWarning("CVid warning in Window: Failed to read from window, code " + std::to_string(GetLastError()));
+					return false;
+				}
+				totalRead += numBytesRead;
+			}
+
+			if (messagesInFlight > 0)
+				messagesInFlight--;
+
+			FrameStatus status;
+			memcpy(&status, buffer + 1, sizeof(status));
+			if (status.sequence == 0)
+				continue;
+
+			//Only this process' clock is used, the timestamp is the one sent with the frame
+			if (status.presented)
+			{
+				int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+				viewerLag = (now - status.timestamp) / 1e9;
+			}
+			else
+			{
+				droppedFrames++;
+			}
+		}
+	}
+
+	//Close the window process or restore the main console
+	void Window::CloseConsole()
+	{
+		if (seperateProcess)
+		{
+			//Close all handles.
+			CloseHandle(processInfo.hProcess);
+			CloseHandle(processInfo.hThread);
+			CloseHandle(outPipe);
+			frameRing.reset();
+		}
+		else
+		{
+			system("cls");
+			//Reset Color and show cursor
+			std::cout << "\x1b[38;2;204;204;204m\x1b[48;2;12;12;12m\x1b[?25h";
+			//Restore original properties
+			SMALL_RECT minSize{ 0, 0, 1, 1 };
+			SetConsoleWindowInfo(consoleOut, true, &minSize);
+			SetConsoleScreenBufferSize(consoleOut, originalSbSize);
+			SetConsoleWindowInfo(consoleOut, true, &originalSize);
+			SetConsoleMode(consoleIn, originalMode);
+			SetConsoleTitle(originalTitle);
+		}
+	}
+
+	//Return true if the window process is still active
+	bool Window::IsAlive(ExitCode* exitCode)
+	{
+		if (alive && seperateProcess)
+		{
+			DWORD code;
+			GetExitCodeProcess(processInfo.hProcess, &code);
+			//If not alive close the handles
+			if (code != STILL_ACTIVE)
+			{
+				CloseWindow();
+			}
+			if (exitCode)
+				*exitCode = code;
+		}
+
+		return alive;
+	}
+
+	//Get the input record of this console window
+	std::vector<INPUT_RECORD> Window::GetInputRecord()
+	{
+		//Get the input from console
+		INPUT_RECORD inputRecord[128];
+		DWORD numRead;
+		PeekConsoleInput(consoleIn, inputRecord, 128, &numRead);
+		FlushConsoleInputBuffer(consoleIn);
+
+		//Put it in a vector for ease of use
+		std::vector<INPUT_RECORD> recordVec;
+		recordVec.reserve(numRead);
+		for (size_t i = 0; i < numRead; i++)
+		{
+			recordVec.push_back(inputRecord[i]);
+		}
+
+		return recordVec;
+	}
+}
+#endif
\ No newline at end of file
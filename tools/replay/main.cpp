@@ -0,0 +1,105 @@
+#include <iostream>
+#include <format>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cvid/Window.h>
+#include <cvid/FrameCapture.h>
+#include <cvid/Helpers.h>
+
+//Plays a capture file made with Window::StartRecording
+//Usage: replay <capture> [--fast] [--headless] [--loops n] [--colors 256|16]
+//--fast plays frames as quickly as they can be presented instead of at the recorded times
+//--headless encodes the frames without writing them anywhere, for measuring the encoder alone
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: replay <capture> [--fast] [--headless] [--loops n] [--colors 256|16]\n";
+		return 1;
+	}
+
+	bool fast = false;
+	bool headless = false;
+	int loops = 1;
+	cvid::ColorMode colorMode = cvid::ColorMode::TrueColor;
+	for (int i = 2; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--fast")
+			fast = true;
+		else if (arg == "--headless")
+			headless = true;
+		else if (arg == "--loops" && i + 1 < argc)
+			loops = std::stoi(argv[++i]);
+		else if (arg == "--colors" && i + 1 < argc)
+			colorMode = std::string(argv[++i]) == "16" ? cvid::ColorMode::Palette16 : cvid::ColorMode::Palette256;
+	}
+
+	cvid::FrameCapture capture(argv[1]);
+	if (capture.GetFrameCount() == 0)
+	{
+		std::cerr << "The capture has no frames\n";
+		return 1;
+	}
+
+	uint16_t width, height;
+	if (!capture.GetFrame(0, width, height))
+	{
+		std::cerr << "The first frame is broken\n";
+		return 1;
+	}
+
+	size_t frames = 0;
+	size_t bytes = 0;
+	double presentTime = 0;
+	double seconds = 0;
+	{
+		cvid::Window window(width, height * 2, "Replay", headless ? cvid::WindowMode::Headless : cvid::WindowMode::Main);
+		cvid::EncoderSettings settings = window.GetEncoderSettings();
+		settings.colorMode = colorMode;
+		window.SetEncoderSettings(settings);
+
+		//Count what would have been written
+		if (headless)
+			window.outputSink = [&](std::string_view part) { bytes += part.size(); };
+
+		auto start = std::chrono::steady_clock::now();
+		for (int loop = 0; loop < loops; loop++)
+		{
+			auto loopStart = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < capture.GetFrameCount(); i++)
+			{
+				uint16_t frameWidth, frameHeight;
+				const cvid::CharPixel* frame = capture.GetFrame(i, frameWidth, frameHeight);
+				if (!frame)
+				{
+					cvid::LogWarning(std::format("Frame {} is broken, stopping", i));
+					break;
+				}
+
+				if (frameWidth != window.GetSize().x || frameHeight * 2 != window.GetSize().y)
+					window.Resize(frameWidth, frameHeight * 2);
+				for (uint16_t y = 0; y < frameHeight; y++)
+					for (uint16_t x = 0; x < frameWidth; x++)
+						window.PutChar(x, y, frame[(size_t)y * frameWidth + x]);
+
+				//Wait until the frame's time from the start of the recording
+				if (!fast)
+					std::this_thread::sleep_until(loopStart + std::chrono::duration<double>(capture.GetTimestamp(i) - capture.GetTimestamp(0)));
+
+				window.DrawFrame();
+				presentTime += window.GetPresentTime();
+				frames++;
+			}
+		}
+		seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::cout << std::format("Replayed {} frames of {}x{} in {:.2f} s, {:.1f} frames/s\n", frames, width, height, seconds, frames / seconds);
+	std::cout << std::format("Average present time {:.3f} ms\n", presentTime / frames * 1000);
+	if (headless)
+		std::cout << std::format("Encoded {} bytes, {:.0f} bytes/frame, {:.1f} MB/s\n", bytes, (double)bytes / frames, bytes / seconds / 1e6);
+	std::cout << std::format("Capture is {} bytes, {:.0f} bytes/frame\n", capture.GetFileSize(), (double)capture.GetFileSize() / capture.GetFrameCount());
+	return 0;
+}
\ No newline at end of file